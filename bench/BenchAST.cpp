@@ -0,0 +1,43 @@
+#include "Util.hpp"
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+
+#include <benchmark/benchmark.h>
+
+//-----------------------------------------------------------------------------
+// util::getFirstLeaf() on an argument of range(0) nested binary operators,
+//  1 + 1 + ... + 1
+// is left-associative, every operator is the first child of the next one
+//-----------------------------------------------------------------------------
+static void BM_GetFirstLeaf(benchmark::State &state) {
+  std::string code = "int f(void) { return 1";
+  for (int64_t i = 0; i < state.range(0); i++) {
+    code += " + 1";
+  }
+  code += "; }\n";
+
+  const auto unit = clang::tooling::buildASTFromCodeWithArgs(code, {"-xc"},
+      "input.c");
+  auto &ctx = unit->getASTContext();
+
+  const Expr* expr = nullptr;
+  for (const auto decl : ctx.getTranslationUnitDecl()->decls()) {
+    if (const auto fn = dyn_cast<FunctionDecl>(decl)) {
+      if (fn->getName() == "f") {
+        const auto body = cast<CompoundStmt>(fn->getBody());
+        expr = cast<ReturnStmt>(body->body_front())->getRetValue();
+      }
+    }
+  }
+  if (expr == nullptr) {
+    state.SkipWithError("Failed to build the AST");
+    return;
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(util::getFirstLeaf(expr, &ctx));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetFirstLeaf)->RangeMultiplier(8)->Range(8, 4096);
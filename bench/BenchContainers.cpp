@@ -0,0 +1,521 @@
+#include "BenchUtil.hpp"
+
+#include "Base.hpp"
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <unordered_set>
+
+// Set by CMake, the builtin headers (stddef.h etc.) of the Clang that the
+// benchmarks are built against
+#ifndef CLANG_RESOURCE_DIR
+#define CLANG_RESOURCE_DIR ""
+#endif
+
+//-----------------------------------------------------------------------------
+// Names: membership of an identifier in the -names-file list
+//-----------------------------------------------------------------------------
+static void BM_NamesUnorderedSet(benchmark::State &state) {
+  const auto names = bench::makeNames(state.range(0));
+  const auto queries = bench::makeQueries(names, 4096);
+  const std::unordered_set<std::string> set(names.begin(), names.end());
+
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      benchmark::DoNotOptimize(set.count(query));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_NamesUnorderedSet)->RangeMultiplier(10)->Range(10, 1000000);
+
+static void BM_NamesStringSet(benchmark::State &state) {
+  const auto names = bench::makeNames(state.range(0));
+  const auto queries = bench::makeQueries(names, 4096);
+  llvm::StringSet<> set;
+  for (const auto &name : names) {
+    set.insert(name);
+  }
+
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      benchmark::DoNotOptimize(set.count(query));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_NamesStringSet)->RangeMultiplier(10)->Range(10, 1000000);
+
+static void BM_NamesSortedVector(benchmark::State &state) {
+  auto names = bench::makeNames(state.range(0));
+  const auto queries = bench::makeQueries(names, 4096);
+  std::sort(names.begin(), names.end());
+
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      benchmark::DoNotOptimize(
+          std::binary_search(names.begin(), names.end(), query));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_NamesSortedVector)->RangeMultiplier(10)->Range(10, 1000000);
+
+//-----------------------------------------------------------------------------
+// renamedLocations: one insert and one lookup per rename in AddSuffix
+//-----------------------------------------------------------------------------
+static void BM_RenamedLocationsInsert(benchmark::State &state) {
+  const auto locations = bench::makeLocations(state.range(0));
+
+  for (auto _ : state) {
+    std::unordered_set<std::string> renamedLocations;
+    for (const auto &location : locations) {
+      renamedLocations.insert(location);
+    }
+    benchmark::DoNotOptimize(renamedLocations.size());
+  }
+  state.SetItemsProcessed(state.iterations() * locations.size());
+}
+BENCHMARK(BM_RenamedLocationsInsert)->RangeMultiplier(10)->Range(100, 100000);
+
+static void BM_RenamedLocationsLookup(benchmark::State &state) {
+  const auto locations = bench::makeLocations(state.range(0));
+  const auto queries = bench::makeQueries(locations, 4096);
+  const std::unordered_set<std::string> renamedLocations(locations.begin(),
+      locations.end());
+
+  for (auto _ : state) {
+    for (const auto &query : queries) {
+      benchmark::DoNotOptimize(renamedLocations.find(query) ==
+          renamedLocations.end());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RenamedLocationsLookup)->RangeMultiplier(10)->Range(100, 100000);
+
+/// The same inserts keyed on the raw encoding of the begin and end
+/// locations rather than their printed form
+static void BM_RenamedLocationsRawInsert(benchmark::State &state) {
+  std::mt19937 rng(bench::SEED);
+  std::vector<std::pair<unsigned, unsigned>> locations(state.range(0));
+  for (auto &location : locations) {
+    location.first = rng() >> 1;
+    location.second = location.first + rng() % 24;
+  }
+
+  for (auto _ : state) {
+    llvm::DenseSet<std::pair<unsigned, unsigned>> renamedLocations;
+    for (const auto &location : locations) {
+      renamedLocations.insert(location);
+    }
+    benchmark::DoNotOptimize(renamedLocations.size());
+  }
+  state.SetItemsProcessed(state.iterations() * locations.size());
+}
+BENCHMARK(BM_RenamedLocationsRawInsert)->RangeMultiplier(10)
+  ->Range(100, 100000);
+
+//-----------------------------------------------------------------------------
+// ArgState: inserts of new and already recorded values, and unions of the
+// states from two chunks of a TU (-jobs)
+//-----------------------------------------------------------------------------
+/// range(0) values drawn from [0, range(1)), i.e. a small range gives
+/// mostly repeated values
+static void BM_ArgStateIntInsert(benchmark::State &state) {
+  std::mt19937 rng(bench::SEED);
+  std::uniform_int_distribution<uint64_t> dist(0, state.range(1) - 1);
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    values.push_back(dist(rng));
+  }
+  StringPool pool;
+
+  for (auto _ : state) {
+    ArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value, pool, /*maxIntRanges=*/64);
+    }
+    benchmark::DoNotOptimize(argState.intStates.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ArgStateIntInsert)
+  ->Args({1024, 8})->Args({1024, 1024})->Args({1024, 1 << 30});
+
+static void BM_ArgStateChrInsert(benchmark::State &state) {
+  std::mt19937 rng(bench::SEED);
+  // Mostly plain characters with the occasional wide character
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    const unsigned value = i % 64 == 0 ? 0x100 + rng() % 1024 : rng() % 128;
+    values.push_back(value);
+  }
+  StringPool pool;
+
+  for (auto _ : state) {
+    ArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value, pool);
+    }
+    benchmark::DoNotOptimize(argState.chrStates.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ArgStateChrInsert)->Arg(1024);
+
+static void BM_ArgStateStrInsert(benchmark::State &state) {
+  const auto strings = bench::makeNames(state.range(1));
+  std::mt19937 rng(bench::SEED);
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    values.push_back(llvm::StringRef(strings[rng() % strings.size()]));
+  }
+
+  for (auto _ : state) {
+    StringPool pool;
+    ArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value, pool);
+    }
+    benchmark::DoNotOptimize(argState.strStates.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_ArgStateStrInsert)->Args({1024, 8})->Args({1024, 1024});
+
+static ArgState makeArgState(StateType type, size_t count, StringPool &pool,
+    uint32_t seed) {
+  std::mt19937 rng(seed);
+  const auto strings = bench::makeNames(count, seed);
+  ArgState argState;
+  argState.type = type;
+  argState.hasType = true;
+  for (size_t i = 0; i < count; i++) {
+    if (type == STR) {
+      argState.addState(llvm::StringRef(strings[i]), pool);
+    } else {
+      argState.addState((uint64_t)(rng() % (count * 4)), pool);
+    }
+  }
+  return argState;
+}
+
+static void BM_ArgStateMerge(benchmark::State &state) {
+  const auto type = static_cast<StateType>(state.range(0));
+  StringPool otherPool;
+  const auto other = makeArgState(type, state.range(1), otherPool,
+      bench::SEED + 1);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringPool pool;
+    auto argState = makeArgState(type, state.range(1), pool, bench::SEED);
+    state.ResumeTiming();
+
+    argState.merge(other, otherPool, pool);
+    benchmark::DoNotOptimize(argState.intStates.size() +
+        argState.strStates.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_ArgStateMerge)
+  ->Args({INT, 16})->Args({INT, 1024})->Args({STR, 16})->Args({STR, 1024});
+
+//-----------------------------------------------------------------------------
+// The previous ArgState layout: node-based ordered sets, nodes identified by
+// Stmt::getID() and every string value copied into the set. The benchmarks
+// below repeat the ArgState benchmarks above with the same inputs.
+//-----------------------------------------------------------------------------
+namespace {
+  using BaselineValue = std::variant<unsigned int, uint64_t, std::string>;
+
+  struct BaselineArgState {
+    std::set<uint64_t> ids;
+    std::set<BaselineValue> states;
+
+    bool addState(const variants &value) {
+      if (const auto str = std::get_if<llvm::StringRef>(&value)) {
+        return this->states.insert(str->str()).second;
+      } else if (const auto chr = std::get_if<unsigned int>(&value)) {
+        return this->states.insert(*chr).second;
+      }
+      return this->states.insert(std::get<uint64_t>(value)).second;
+    }
+
+    void merge(const BaselineArgState &other) {
+      this->ids.insert(other.ids.begin(), other.ids.end());
+      this->states.insert(other.states.begin(), other.states.end());
+    }
+  };
+}
+
+static void BM_BaselineArgStateIntInsert(benchmark::State &state) {
+  std::mt19937 rng(bench::SEED);
+  std::uniform_int_distribution<uint64_t> dist(0, state.range(1) - 1);
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    values.push_back(dist(rng));
+  }
+
+  for (auto _ : state) {
+    BaselineArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value);
+    }
+    benchmark::DoNotOptimize(argState.states.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_BaselineArgStateIntInsert)
+  ->Args({1024, 8})->Args({1024, 1024})->Args({1024, 1 << 30});
+
+static void BM_BaselineArgStateChrInsert(benchmark::State &state) {
+  std::mt19937 rng(bench::SEED);
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    const unsigned value = i % 64 == 0 ? 0x100 + rng() % 1024 : rng() % 128;
+    values.push_back(value);
+  }
+
+  for (auto _ : state) {
+    BaselineArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value);
+    }
+    benchmark::DoNotOptimize(argState.states.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_BaselineArgStateChrInsert)->Arg(1024);
+
+static void BM_BaselineArgStateStrInsert(benchmark::State &state) {
+  const auto strings = bench::makeNames(state.range(1));
+  std::mt19937 rng(bench::SEED);
+  std::vector<variants> values;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    values.push_back(llvm::StringRef(strings[rng() % strings.size()]));
+  }
+
+  for (auto _ : state) {
+    BaselineArgState argState;
+    for (const auto &value : values) {
+      argState.addState(value);
+    }
+    benchmark::DoNotOptimize(argState.states.size());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_BaselineArgStateStrInsert)->Args({1024, 8})->Args({1024, 1024});
+
+static BaselineArgState makeBaselineArgState(StateType type, size_t count,
+    uint32_t seed) {
+  std::mt19937 rng(seed);
+  const auto strings = bench::makeNames(count, seed);
+  BaselineArgState argState;
+  for (size_t i = 0; i < count; i++) {
+    if (type == STR) {
+      argState.addState(llvm::StringRef(strings[i]));
+    } else {
+      argState.addState((uint64_t)(rng() % (count * 4)));
+    }
+  }
+  return argState;
+}
+
+static void BM_BaselineArgStateMerge(benchmark::State &state) {
+  const auto type = static_cast<StateType>(state.range(0));
+  const auto other = makeBaselineArgState(type, state.range(1),
+      bench::SEED + 1);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto argState = makeBaselineArgState(type, state.range(1), bench::SEED);
+    state.ResumeTiming();
+
+    argState.merge(other);
+    benchmark::DoNotOptimize(argState.states.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_BaselineArgStateMerge)
+  ->Args({INT, 16})->Args({INT, 1024})->Args({STR, 16})->Args({STR, 1024});
+
+//-----------------------------------------------------------------------------
+// Both layouts on the arguments of a call-site-heavy TU from gen_project.py
+//
+//  ./bench/gen_project.py /tmp/heavy --tus 1 --functions 4096 \
+//    --calls-per-function 16 --density 1
+//  BENCH_PROJECT=/tmp/heavy ./build/bin/bench --benchmark_filter=LayoutTU
+//
+// The first pass records every argument of a call to the first function in
+// <project>/targets.txt in src/tu_0.c: its node and, for literals, its
+// value. The second pass looks up the node of every argument again. Node
+// IDs for the previous layout are computed up front, only the containers
+// are compared. Skipped unless BENCH_PROJECT is set.
+//-----------------------------------------------------------------------------
+namespace {
+  struct RecordedArgument {
+    unsigned param;
+    const clang::Stmt* node;
+    uint64_t id;
+    std::optional<variants> value;
+  };
+
+  class ArgumentCollector : public MatchFinder::MatchCallback {
+  public:
+    explicit ArgumentCollector(std::vector<RecordedArgument> &arguments)
+      : arguments(arguments) {}
+
+    void run(const MatchFinder::MatchResult &result) override {
+      const auto* call = result.Nodes.getNodeAs<CallExpr>("call");
+      for (unsigned i = 0; i < call->getNumArgs(); i++) {
+        const auto* arg = call->getArg(i)->IgnoreParenImpCasts();
+        std::optional<variants> value;
+        if (const auto* integer = dyn_cast<IntegerLiteral>(arg)) {
+          value = integer->getValue().getZExtValue();
+        } else if (const auto* chr = dyn_cast<CharacterLiteral>(arg)) {
+          value = chr->getValue();
+        } else if (const auto* str = dyn_cast<StringLiteral>(arg)) {
+          if (str->getCharByteWidth() == 1) {
+            value = str->getString();
+          }
+        }
+        this->arguments.push_back({i, arg, arg->getID(*result.Context),
+            value});
+      }
+    }
+
+  private:
+    std::vector<RecordedArgument> &arguments;
+  };
+
+  struct LayoutInput {
+    std::unique_ptr<clang::ASTUnit> unit;
+    std::vector<RecordedArgument> arguments;
+    unsigned params = 0;
+  };
+}
+
+/// The arguments of src/tu_0.c in $BENCH_PROJECT, parsed on first use
+static const LayoutInput* getLayoutInput(std::string &error) {
+  static LayoutInput input;
+  static std::string loadError;
+  static bool loaded = false;
+  if (loaded) {
+    error = loadError;
+    return loadError.empty() ? &input : nullptr;
+  }
+  loaded = true;
+
+  const char* project = getenv("BENCH_PROJECT");
+  if (project == nullptr) {
+    error = loadError = "BENCH_PROJECT is not set";
+    return nullptr;
+  }
+  const auto targets = llvm::MemoryBuffer::getFile(
+      std::string(project) + "/targets.txt");
+  std::string dbError;
+  auto db = clang::tooling::CompilationDatabase::loadFromDirectory(project,
+      dbError);
+  if (!targets || !db) {
+    error = loadError = "Not a gen_project.py project: " +
+                        std::string(project);
+    return nullptr;
+  }
+  const auto symbol = (*targets)->getBuffer().split('\n').first.trim();
+
+  clang::tooling::ClangTool tool(*db,
+      {std::string(project) + "/src/tu_0.c"});
+  if (*CLANG_RESOURCE_DIR != '\0') {
+    tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+          {"-resource-dir", CLANG_RESOURCE_DIR},
+          clang::tooling::ArgumentInsertPosition::END));
+  }
+  std::vector<std::unique_ptr<clang::ASTUnit>> units;
+  if (tool.buildASTs(units) != 0 || units.size() != 1) {
+    error = loadError = "Failed to parse src/tu_0.c";
+    return nullptr;
+  }
+  input.unit = std::move(units.front());
+
+  ArgumentCollector collector(input.arguments);
+  MatchFinder finder;
+  finder.addMatcher(callExpr(callee(functionDecl(hasName(symbol))))
+      .bind("call"), &collector);
+  finder.matchAST(input.unit->getASTContext());
+  for (const auto &argument : input.arguments) {
+    input.params = std::max(input.params, argument.param + 1);
+  }
+  if (input.arguments.empty()) {
+    error = loadError = "No calls to " + symbol.str() + " in src/tu_0.c";
+    return nullptr;
+  }
+  return &input;
+}
+
+static void BM_ArgStateLayoutTU(benchmark::State &state) {
+  std::string error;
+  const auto* input = getLayoutInput(error);
+  if (input == nullptr) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  for (auto _ : state) {
+    StringPool pool;
+    std::vector<ArgState> argStates(input->params);
+    for (const auto &argument : input->arguments) {
+      auto &argState = argStates[argument.param];
+      argState.ids.insert(argument.node);
+      if (argument.value) {
+        argState.addState(*argument.value, pool);
+      }
+    }
+    size_t found = 0;
+    for (const auto &argument : input->arguments) {
+      found += argStates[argument.param].ids.count(argument.node);
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * input->arguments.size());
+}
+BENCHMARK(BM_ArgStateLayoutTU);
+
+static void BM_BaselineArgStateLayoutTU(benchmark::State &state) {
+  std::string error;
+  const auto* input = getLayoutInput(error);
+  if (input == nullptr) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  for (auto _ : state) {
+    std::vector<BaselineArgState> argStates(input->params);
+    for (const auto &argument : input->arguments) {
+      auto &argState = argStates[argument.param];
+      argState.ids.insert(argument.id);
+      if (argument.value) {
+        argState.addState(*argument.value);
+      }
+    }
+    size_t found = 0;
+    for (const auto &argument : input->arguments) {
+      found += argStates[argument.param].ids.count(argument.id);
+    }
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * input->arguments.size());
+}
+BENCHMARK(BM_BaselineArgStateLayoutTU);
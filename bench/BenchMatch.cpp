@@ -0,0 +1,63 @@
+#include "ArgStates.hpp"
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+
+#include <benchmark/benchmark.h>
+
+#include "MatchRecorder.hpp"
+
+//-----------------------------------------------------------------------------
+// The matches of range(0) call sites in a TU, every call passes the same
+// literal values. The matches of the first half of the call sites are
+// handled to record the values, the allocations are counted for the second
+// half where every value has already been recorded (the steady state).
+// The matches are recorded once and replayed to a new FirstPassMatcher on
+// every iteration, i.e. the allocations of the MatchFinder itself are not
+// included.
+//-----------------------------------------------------------------------------
+static void BM_FirstPassSteadyState(benchmark::State &state) {
+  std::string code = "int target(int n, const char* s, char c, "
+                     "unsigned long size);\n";
+  for (int64_t i = 0; i < state.range(0); i++) {
+    code += "int f" + std::to_string(i) + "(void) { "
+            "return target(1, \"str\", 'c', sizeof(int)); }\n";
+  }
+  const auto unit = clang::tooling::buildASTFromCodeWithArgs(code, {"-xc"},
+      "input.c");
+  auto &ctx = unit->getASTContext();
+
+  const ArgStatesOptions options;
+  const auto matches = test::recordFirstPassMatches(ctx, "target", options);
+  if (matches.empty()) {
+    state.SkipWithError("No matches recorded");
+    return;
+  }
+  const size_t warmUp = matches.size() / 2;
+
+  uint64_t allocs = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringPool pool;
+    FirstPassMatcher handler(options, pool);
+    for (size_t i = 0; i < warmUp; i++) {
+      test::replayMatch(handler, matches[i], ctx);
+    }
+    state.ResumeTiming();
+
+    const auto before = test::getAllocCount();
+    for (size_t i = warmUp; i < matches.size(); i++) {
+      test::replayMatch(handler, matches[i], ctx);
+    }
+    allocs += test::getAllocCount() - before;
+  }
+
+  const size_t measured = matches.size() - warmUp;
+  state.SetItemsProcessed(state.iterations() * measured);
+  // Every call site is new, only the amortized growth of the per-TU record
+  // of call sites should remain. Matches of call sites that have already
+  // been handled must not allocate at all, see test/AllocTest.cpp.
+  state.counters["allocs/match"] = benchmark::Counter(
+      (double)allocs / (state.iterations() * measured));
+}
+BENCHMARK(BM_FirstPassSteadyState)->RangeMultiplier(8)->Range(64, 4096);
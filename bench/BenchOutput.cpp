@@ -0,0 +1,73 @@
+#include "BenchUtil.hpp"
+
+#include "ArgStates.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+
+//-----------------------------------------------------------------------------
+// Output: writeStates() and writeArgStates() (dumpArgStates() without
+// opening the file) for range(0) parameters with range(1) states each
+//-----------------------------------------------------------------------------
+static std::vector<ArgState> makeArgStates(StateType type, size_t params,
+    size_t states, StringPool &pool) {
+  std::mt19937 rng(bench::SEED);
+  const auto strings = bench::makeNames(states);
+  std::vector<ArgState> argumentStates(params);
+
+  for (size_t i = 0; i < params; i++) {
+    auto &argState = argumentStates[i];
+    argState.paramName = "param" + std::to_string(i);
+    argState.type = type;
+    argState.hasType = true;
+    for (size_t k = 0; k < states; k++) {
+      switch (type) {
+        case STR:
+          argState.addState(llvm::StringRef(strings[k]), pool);
+          break;
+        case CHR:
+          argState.addState((unsigned)(rng() % 256), pool);
+          break;
+        default:
+          // Sparse values, few of them are coalesced into intervals
+          argState.addState((uint64_t)(rng() % (states * 16)), pool);
+      }
+    }
+  }
+  return argumentStates;
+}
+
+static void BM_WriteStates(benchmark::State &state) {
+  const auto type = static_cast<StateType>(state.range(0));
+  StringPool pool;
+  const auto argumentStates = makeArgStates(type, 1, state.range(1), pool);
+  std::ostringstream f;
+
+  for (auto _ : state) {
+    f.str(std::string());
+    writeStates(argumentStates[0], f, /*intRanges=*/false, pool);
+    benchmark::DoNotOptimize(f.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * f.str().size());
+}
+BENCHMARK(BM_WriteStates)
+  ->Args({INT, 64})->Args({INT, 4096})
+  ->Args({CHR, 64})->Args({CHR, 256})
+  ->Args({STR, 64})->Args({STR, 4096});
+
+static void BM_WriteArgStates(benchmark::State &state) {
+  StringPool pool;
+  const auto argumentStates = makeArgStates(INT, state.range(0),
+      state.range(1), pool);
+  const ArgStatesOptions options;
+  std::ostringstream f;
+
+  for (auto _ : state) {
+    f.str(std::string());
+    writeArgStates(f, "XML_Parse", argumentStates, options, pool);
+    benchmark::DoNotOptimize(f.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * f.str().size());
+}
+BENCHMARK(BM_WriteArgStates)->Args({4, 64})->Args({16, 1024});
@@ -0,0 +1,73 @@
+#include "BenchUtil.hpp"
+
+#include <cstdio>
+#include <iterator>
+#include <unordered_set>
+
+namespace bench {
+  static const char* PREFIXES[] = {
+    "xml", "onig", "libusb", "jv", "parse", "get", "set", "alloc", "free"
+  };
+  static const char* FILES[] = {
+    "lib/xmlparse.c", "lib/xmlrole.c", "src/regexec.c", "src/regparse.c",
+    "libusb/core.c", "libusb/io.c", "src/jv_parse.c", "src/execute.c"
+  };
+
+  std::vector<std::string> makeNames(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> prefix(0, std::size(PREFIXES) - 1);
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> names;
+    names.reserve(count);
+
+    while (names.size() < count) {
+      char suffix[16];
+      snprintf(suffix, sizeof(suffix), "_%x", (unsigned)rng());
+      auto name = std::string(PREFIXES[prefix(rng)]) + suffix;
+      if (seen.insert(name).second) {
+        names.push_back(std::move(name));
+      }
+    }
+    return names;
+  }
+
+  std::vector<std::string> makeLocations(size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> file(0, std::size(FILES) - 1);
+    std::uniform_int_distribution<unsigned> line(1, 20000);
+    std::uniform_int_distribution<unsigned> col(1, 80);
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> locations;
+    locations.reserve(count);
+
+    while (locations.size() < count) {
+      const unsigned begin = col(rng);
+      auto location = "<" + std::string(FILES[file(rng)]) + ":" +
+                      std::to_string(line(rng)) + ":" +
+                      std::to_string(begin) + ", col:" +
+                      std::to_string(begin + col(rng) % 24) + ">";
+      if (seen.insert(location).second) {
+        locations.push_back(std::move(location));
+      }
+    }
+    return locations;
+  }
+
+  std::vector<std::string> makeQueries(const std::vector<std::string> &hits,
+      size_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> index(0, hits.size() - 1);
+    std::vector<std::string> queries;
+    queries.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+      auto query = hits[index(rng)];
+      if (i % 2 == 1) {
+        // Same length and prefix as a hit, differs in the last character
+        query.back() = query.back() == '~' ? '!' : '~';
+      }
+      queries.push_back(std::move(query));
+    }
+    return queries;
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef Bench_Util_H
+#define Bench_Util_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Synthetic inputs for the benchmarks
+// Every generator takes its own fixed seed so that a benchmark sees the
+// same input on every run and on every machine.
+//-----------------------------------------------------------------------------
+namespace bench {
+  static constexpr uint32_t SEED = 0x5eed;
+
+  /// 'count' distinct C identifiers, e.g. 'xml_parse_3f2a'
+  std::vector<std::string> makeNames(size_t count, uint32_t seed = SEED);
+
+  /// 'count' distinct locations in the format of
+  /// SourceRange::printToString(), e.g. '<lib/xmlparse.c:412:7, col:18>'
+  std::vector<std::string> makeLocations(size_t count, uint32_t seed = SEED);
+
+  /// Values to look up, every other value is a hit
+  std::vector<std::string> makeQueries(const std::vector<std::string> &hits,
+      size_t count, uint32_t seed = SEED);
+}
+
+#endif
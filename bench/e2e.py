@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+'''
+Run AddSuffix and/or ArgStates over every TU of a project generated with
+gen_project.py (or any project with a compile_commands.json, given
+--names-file and --symbols) and report TUs/sec, the CPU time per call site
+and the peak RSS of the clang processes.
+
+  ./bench/gen_project.py /tmp/synth --tus 64
+  ./bench/e2e.py /tmp/synth --jobs 8
+'''
+import argparse, json, os, shlex, subprocess, sys, tempfile, time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+BASE_DIR = str(Path(__file__).parent.parent.absolute())
+PLUGINS = [ 'AddSuffix', 'ArgStates' ]
+
+def plugin_flags(plugin: str, lib: str, plugin_args: list) -> list:
+    flags = [ '-Xclang', '-load', '-Xclang', lib,
+              '-Xclang', '-plugin', '-Xclang', plugin ]
+    for arg in plugin_args:
+        flags += [ '-Xclang', f"-plugin-arg-{plugin}", '-Xclang', arg ]
+    return flags
+
+def compile_args(entry: dict) -> list:
+    '''
+    The compiler arguments of an entry without the compiler, the output
+    and the -c flag
+    '''
+    if 'arguments' in entry:
+        argv = list(entry['arguments'])
+    else:
+        argv = shlex.split(entry['command'])
+    out = []
+    skip = False
+    for arg in argv[1:]:
+        if skip:
+            skip = False
+        elif arg == '-o':
+            skip = True
+        elif arg != '-c':
+            out.append(arg)
+    return out
+
+def run_tu(clang: str, flags: list, entry: dict, env: dict) -> dict:
+    '''
+    Run one clang process and return its wall time, CPU time (user and
+    system) and peak RSS (bytes)
+    '''
+    cmd = [ clang, '-fsyntax-only' ] + flags + compile_args(entry)
+    start = time.monotonic()
+    proc = subprocess.Popen(cmd, cwd=entry['directory'], env=env,
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE)
+    stderr = proc.stderr.read()
+    _, status, rusage = os.wait4(proc.pid, 0)
+    proc.returncode = os.waitstatus_to_exitcode(status)
+    return {
+        'file': entry['file'],
+        'time': time.monotonic() - start,
+        'cpu': rusage.ru_utime + rusage.ru_stime,
+        # Given in kilobytes on Linux, a lower bound of a few MiB is set by
+        # the memory of the forked interpreter before exec()
+        'rss': rusage.ru_maxrss * 1024,
+        'ok': proc.returncode == 0,
+        'stderr': stderr.decode('utf8', errors='replace')
+    }
+
+def run_plugin(args, plugin: str, entries: list, symbol: str = '') -> dict:
+    lib = f"{args.lib_dir}/lib{plugin}.so"
+    env = os.environ.copy()
+
+    if plugin == 'AddSuffix':
+        plugin_args = [ '-names-file', args.names_file,
+                        '-suffix', args.suffix ]
+    else:
+        plugin_args = [ '-symbol-name', symbol ]
+        env['ARG_STATES_OUT_DIR'] = args.states_dir
+    plugin_args += args.plugin_arg
+    flags = plugin_flags(plugin, lib, plugin_args)
+
+    start = time.monotonic()
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        results = list(pool.map(lambda e: run_tu(args.clang, flags, e, env),
+                                entries))
+    wall = time.monotonic() - start
+
+    failed = [ r for r in results if not r['ok'] ]
+    for r in failed[:3]:
+        print(f"!> {plugin} failed for {r['file']}:\n{r['stderr']}",
+              file=sys.stderr)
+
+    return {
+        'plugin': plugin,
+        'symbol': symbol,
+        'tus': len(results),
+        'failed': len(failed),
+        'wall': wall,
+        'cpu': sum(r['cpu'] for r in results),
+        'peak_rss': max((r['rss'] for r in results), default=0),
+        'mean_rss': sum(r['rss'] for r in results) / max(len(results), 1)
+    }
+
+def print_report(report: dict, call_sites: int):
+    tus_per_sec = report['tus'] / report['wall'] if report['wall'] else 0
+    name = report['plugin'] + (f" ({report['symbol']})"
+                               if report['symbol'] else '')
+    print(f"===> {name} <===")
+    print(f"  TUs               {report['tus']:10} ({report['failed']} failed)")
+    print(f"  wall              {report['wall']:10.3f} s")
+    print(f"  TUs/sec           {tus_per_sec:10.2f}")
+    print(f"  CPU               {report['cpu']:10.3f} s")
+    if call_sites:
+        print(f"  CPU/call site     "
+              f"{report['cpu'] / call_sites * 1e6:10.1f} us")
+    print(f"  peak RSS          {report['peak_rss'] / 2**20:10.1f} MiB")
+    print(f"  mean RSS          {report['mean_rss'] / 2**20:10.1f} MiB")
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('project', help='Directory with compile_commands.json')
+    parser.add_argument('--plugin', choices=PLUGINS + ['both'], default='both')
+    parser.add_argument('--clang', default='clang')
+    parser.add_argument('--lib-dir', default=f"{BASE_DIR}/build/lib")
+    parser.add_argument('--jobs', type=int, default=os.cpu_count(),
+            help='Number of concurrent clang processes')
+    parser.add_argument('--names-file',
+            help='Defaults to <project>/names.txt')
+    parser.add_argument('--symbols',
+            help='Comma separated symbols for ArgStates, defaults to '
+                 '<project>/targets.txt')
+    parser.add_argument('--suffix', default='_old_aaaaaaa')
+    parser.add_argument('--plugin-arg', action='append', default=[],
+            help='Extra argument for the plugin(s), e.g. --plugin-arg=-stream')
+    parser.add_argument('--output', help='Write the reports as JSON')
+    args = parser.parse_args()
+
+    project = os.path.abspath(args.project)
+    with open(f"{project}/compile_commands.json", encoding='utf8') as f:
+        entries = json.load(f)
+
+    # Unknown (0) for projects that were not generated with gen_project.py
+    call_sites = 0
+    target_call_sites = {}
+    if os.path.exists(f"{project}/manifest.json"):
+        with open(f"{project}/manifest.json", encoding='utf8') as f:
+            manifest = json.load(f)
+        call_sites = manifest['call_sites']
+        target_call_sites = manifest.get('target_call_sites', {})
+
+    args.names_file = args.names_file or f"{project}/names.txt"
+    if args.symbols:
+        symbols = args.symbols.split(',')
+    else:
+        with open(f"{project}/targets.txt", encoding='utf8') as f:
+            symbols = [ line.strip() for line in f if line.strip() ]
+
+    reports = []
+    with tempfile.TemporaryDirectory() as states_dir:
+        args.states_dir = states_dir
+        if args.plugin in ('AddSuffix', 'both'):
+            reports.append(run_plugin(args, 'AddSuffix', entries))
+        if args.plugin in ('ArgStates', 'both'):
+            for symbol in symbols:
+                reports.append(run_plugin(args, 'ArgStates', entries, symbol))
+
+    for report in reports:
+        # AddSuffix renames the calls to every target, an ArgStates run
+        # only matches the calls to its symbol
+        if report['symbol']:
+            report['call_sites'] = target_call_sites.get(report['symbol'], 0)
+        else:
+            report['call_sites'] = call_sites
+        print_report(report, report['call_sites'])
+
+    if args.output:
+        with open(args.output, mode='w', encoding='utf8') as f:
+            json.dump({ 'call_sites': call_sites, 'reports': reports }, f,
+                      indent=2)
+
+if __name__ == '__main__':
+    main()
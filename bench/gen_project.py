@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+'''
+Generate a synthetic C project with a compilation database for end-to-end
+benchmarks of the plugins (see e2e.py). The output only depends on the
+parameters and the seed.
+
+  <out>/include/hdr_<k>.h     Declarations, constants and wrapper macros
+  <out>/include/targets.h     The target functions that are called
+  <out>/src/tu_<i>.c          Functions with call sites to the targets
+  <out>/compile_commands.json
+  <out>/names.txt             -names-file for AddSuffix
+  <out>/targets.txt           One -symbol-name per line for ArgStates
+  <out>/manifest.json         The parameters and the number of call sites
+'''
+import argparse, json, os, random
+
+def parse_mix(mix: str) -> dict:
+    '''
+    'literal:declref:macro' weights, e.g. '6:3:1'
+    '''
+    weights = [ int(w) for w in mix.split(':') ]
+    if len(weights) != 3 or sum(weights) == 0 or min(weights) < 0:
+        raise argparse.ArgumentTypeError(f"invalid argument mix: '{mix}'")
+    return dict(zip(('literal', 'declref', 'macro'), weights))
+
+def literal(rng: random.Random, param_type: str) -> str:
+    if param_type == 'int':
+        # Mostly small flag-like values, which coalesce into intervals
+        return str(rng.choice([ rng.randint(0, 16), rng.randint(0, 1 << 20) ]))
+    if param_type == 'char':
+        return f"'{rng.choice('abcdefxyz0123')}'"
+    return f'"str_{rng.randint(0, 64)}"'
+
+def write_headers(args, rng: random.Random, targets: list) -> list:
+    os.makedirs(f"{args.out}/include", exist_ok=True)
+
+    with open(f"{args.out}/include/targets.h", mode='w', encoding='utf8') as f:
+        f.write("#ifndef TARGETS_H\n#define TARGETS_H\n\n")
+        for name, params in targets:
+            decl = ', '.join(f"{t}{'*' if t == 'const char' else ''} p{k}"
+                             for k, t in enumerate(params))
+            f.write(f"int {name}({decl});\n")
+        f.write("\n#endif\n")
+
+    headers = []
+    for k in range(args.headers):
+        header = f"hdr_{k}.h"
+        guard = f"HDR_{k}_H"
+        with open(f"{args.out}/include/{header}", mode='w',
+                  encoding='utf8') as f:
+            f.write(f"#ifndef {guard}\n#define {guard}\n\n")
+            f.write('#include "targets.h"\n\n')
+            f.write(f"#define CONST_{k} {rng.randint(0, 255)}\n")
+            # Calls through a macro are expanded at the call site
+            name, params = targets[k % len(targets)]
+            args_list = ', '.join(f"a{i}" for i in range(len(params)))
+            f.write(f"#define CALL_{k}({args_list}) {name}({args_list})\n\n")
+            for i in range(args.decls_per_header):
+                f.write(f"int hdr_{k}_fn_{i}(int x);\n")
+                f.write(f"static inline int hdr_{k}_inline_{i}(int x) "
+                        f"{{ return x * {i + 1} + CONST_{k}; }}\n")
+            f.write("\n#endif\n")
+        headers.append(header)
+    return headers
+
+def argument(args, rng: random.Random, param_type: str, locals_: dict,
+             header: int) -> str:
+    kind = rng.choices(list(args.mix.keys()),
+                       weights=list(args.mix.values()))[0]
+    if kind == 'declref' and locals_[param_type]:
+        return rng.choice(locals_[param_type])
+    if kind == 'macro' and param_type == 'int':
+        return f"CONST_{header}"
+    return literal(rng, param_type)
+
+def write_tu(args, rng: random.Random, i: int, targets: list,
+             headers: list, target_call_sites: dict) -> int:
+    '''
+    Returns the number of call sites to the targets, the call sites of
+    each target are added to target_call_sites
+    '''
+    includes = rng.sample(range(len(headers)), min(args.headers_per_tu,
+                                                   len(headers)))
+    call_sites = 0
+    lines = [ '#include <stddef.h>' ]
+    lines += [ f'#include "{headers[k]}"' for k in includes ]
+    lines.append('')
+
+    for fn in range(args.functions):
+        lines.append(f"int tu_{i}_fn_{fn}(int n, const char* s) {{")
+        lines.append(f"  int v = n + {fn};")
+        lines.append(f"  char c = s[0];")
+        lines.append(f"  int r = 0;")
+        locals_ = { 'int': [ 'n', 'v' ], 'char': [ 'c' ],
+                    'const char': [ 's' ] }
+
+        for _ in range(args.calls_per_function):
+            if rng.random() >= args.density:
+                # Calls to other functions, these are not matched
+                k = rng.choice(includes) if includes else 0
+                if includes:
+                    lines.append(f"  r += hdr_{k}_inline_"
+                                 f"{rng.randrange(args.decls_per_header)}(v);")
+                continue
+
+            header = rng.choice(includes) if includes else 0
+            target = rng.randrange(len(targets))
+            name, params = targets[target]
+            call_args = ', '.join(argument(args, rng, t, locals_, header)
+                                  for t in params)
+            if includes and target == header % len(targets) and \
+               args.mix['macro'] > 0 and rng.random() < 0.5:
+                lines.append(f"  r += CALL_{header}({call_args});")
+            else:
+                lines.append(f"  r += {name}({call_args});")
+            call_sites += 1
+            target_call_sites[name] = target_call_sites.get(name, 0) + 1
+
+        lines.append("  return r;")
+        lines.append("}\n")
+
+    with open(f"{args.out}/src/tu_{i}.c", mode='w', encoding='utf8') as f:
+        f.write('\n'.join(lines))
+    return call_sites
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('out', help='Output directory')
+    parser.add_argument('--tus', type=int, default=32)
+    parser.add_argument('--headers', type=int, default=16,
+            help='Number of headers in the project')
+    parser.add_argument('--headers-per-tu', type=int, default=4)
+    parser.add_argument('--decls-per-header', type=int, default=32)
+    parser.add_argument('--functions', type=int, default=64,
+            help='Functions per TU')
+    parser.add_argument('--calls-per-function', type=int, default=8)
+    parser.add_argument('--density', type=float, default=0.25,
+            help='Fraction of calls that are calls to a target')
+    parser.add_argument('--targets', type=int, default=4,
+            help='Number of target functions')
+    parser.add_argument('--mix', type=parse_mix, default=parse_mix('6:3:1'),
+            help='literal:declref:macro weights for the arguments of '
+                 'target calls (default 6:3:1)')
+    parser.add_argument('--names', type=int, default=100,
+            help='Size of the names list for AddSuffix')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    os.makedirs(f"{args.out}/src", exist_ok=True)
+
+    targets = []
+    for t in range(args.targets):
+        params = [ rng.choice(['int', 'char', 'const char'])
+                   for _ in range(rng.randint(1, 4)) ]
+        targets.append((f"target_{t}", params))
+
+    headers = write_headers(args, rng, targets)
+
+    commands = []
+    call_sites = 0
+    target_call_sites = { name: 0 for name, _ in targets }
+    for i in range(args.tus):
+        call_sites += write_tu(args, rng, i, targets, headers,
+                               target_call_sites)
+        commands.append({
+            'directory': os.path.abspath(args.out),
+            'file': f"src/tu_{i}.c",
+            'arguments': [ 'clang', '-c', '-Iinclude', f"src/tu_{i}.c" ]
+        })
+
+    with open(f"{args.out}/compile_commands.json", mode='w',
+              encoding='utf8') as f:
+        json.dump(commands, f, indent=2)
+
+    # The targets and header functions first, padded with names that
+    # do not occur in the project
+    names = [ name for name, _ in targets ]
+    names += [ f"hdr_{k}_fn_{i}" for k in range(args.headers)
+               for i in range(args.decls_per_header) ]
+    names = names[:args.names]
+    names += [ f"unused_{n}" for n in range(args.names - len(names)) ]
+    with open(f"{args.out}/names.txt", mode='w', encoding='utf8') as f:
+        f.write('\n'.join(names) + '\n')
+
+    with open(f"{args.out}/targets.txt", mode='w', encoding='utf8') as f:
+        f.write('\n'.join(name for name, _ in targets) + '\n')
+
+    manifest = vars(args).copy()
+    manifest['mix'] = args.mix
+    manifest['call_sites'] = call_sites
+    manifest['target_call_sites'] = target_call_sites
+    with open(f"{args.out}/manifest.json", mode='w', encoding='utf8') as f:
+        json.dump(manifest, f, indent=2)
+
+    print(f"===> {args.tus} TU(s), {call_sites} call site(s) in {args.out}")
+
+if __name__ == '__main__':
+    main()
@@ -1,6 +1,7 @@
 #ifndef CLANG_TUTOR_AddSuffix_H
 #define CLANG_TUTOR_AddSuffix_H
 
+#include <climits>
 #include <unordered_set>
 #include "clang/AST/ASTConsumer.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
@@ -8,7 +9,16 @@
 #include "clang/Rewrite/Frontend/FixItRewriter.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 
-#define DEBUG_AST false
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Output.hpp"
+#include "Parallel.hpp"
+#include "Profile.hpp"
+#include "Replay.hpp"
+#include "Skip.hpp"
+#include "Stream.hpp"
+#include "StringPool.hpp"
+#include "Trace.hpp"
 
 #define hasNames10(arr,end) hasName(arr[end]), hasName(arr[end-1]), \
   hasName(arr[end-2]), hasName(arr[end-3]), hasName(arr[end-4]), \
@@ -49,9 +59,8 @@
 					  .bind("DeclRefExpr"); \
  \
  \
-    Finder.addMatcher(matcherForFunctionDecl, &(this->AddSuffixHandler)); \
-    Finder.addMatcher(matcherForVarDecl,      &(this->AddSuffixHandler)); \
-    Finder.addMatcher(matcherForRefExpr,      &(this->AddSuffixHandler)); \
+    this->addMatcherBatch(matcherForFunctionDecl, matcherForVarDecl, \
+			  matcherForRefExpr); \
  \
 } while (0)
 
@@ -61,39 +70,33 @@ using namespace ast_matchers;
 
 //-----------------------------------------------------------------------------
 // ASTFinder callback
+// Records the renames for every match, these are applied to the source
+// by the AddSuffixASTConsumer once all matches have been found
 //-----------------------------------------------------------------------------
+struct Rename {
+  SourceRange SrcRange;
+  // References the identifier table of the ASTContext, or a StringPool
+  // with -jobs
+  StringRef NodeName;
+  const char* BindName;
+};
+
 class AddSuffixMatcher
     : public MatchFinder::MatchCallback {
 public:
-  explicit AddSuffixMatcher(Rewriter &RewriterForAddSuffix, 
-      std::string Suffix)
-      : AddSuffixRewriter(RewriterForAddSuffix), Suffix(Suffix)  {}
-
-  void onEndOfTranslationUnit() override;
+  explicit AddSuffixMatcher() {}
 
   void run(const MatchFinder::MatchResult &) override;
 
+  std::vector<Rename> Renames;
+
 private:
   void replaceInDeclRefMatch(
     const MatchFinder::MatchResult &result, 
-    std::string bindName);
+    const char* bindName);
   void replaceInDeclMatch(
     const MatchFinder::MatchResult &result, 
-    std::string bindName);
-  void replaceInMatch(
-    const MatchFinder::MatchResult &result, std::string bindName,
-    SourceRange srcRange, std::string nodeName);
-
-  // To avoid renaming the same token several times
-  // we maintain a set of all locations which have been modified
-  std::unordered_set<std::string> renamedLocations = 
-	  std::unordered_set<std::string>({});
-
-  Rewriter AddSuffixRewriter;
-  // NOTE: This matcher already knows *what* name to search for 
-  // because it _matched_ an expression that corresponds to
-  // the command line arguments.
-  std::string Suffix;
+    const char* bindName);
 };
 
 //-----------------------------------------------------------------------------
@@ -102,18 +105,95 @@ private:
 class AddSuffixASTConsumer : public ASTConsumer {
 public:
   AddSuffixASTConsumer(Rewriter &R, 
-      std::vector<std::string> Names, std::string Suffix
+      std::vector<std::string> Names, std::string Suffix, unsigned Jobs,
+      bool Stream, std::string ProfileDir, bool MemoryReport,
+      std::unique_ptr<trace::Session> TraceSession,
+      std::unique_ptr<metrics::Record> TUMetrics,
+      std::unique_ptr<replay::Bundle> Bundle,
+      std::unique_ptr<skip::BodyFilter> BodyFilter,
+      std::shared_ptr<CompilerInvocation> Invocation
   );
 
-  void HandleTranslationUnit(ASTContext &Ctx) override {
-    Finder.matchAST(Ctx);
-  }
+  void Initialize(ASTContext &Ctx) override;
+  bool HandleTopLevelDecl(DeclGroupRef DG) override;
+  void HandleInlineFunctionDefinition(FunctionDecl *D) override;
+  void HandleTranslationUnit(ASTContext &Ctx) override;
+  bool shouldSkipFunctionBody(Decl *D) override;
 
 private:
+  void addMatcherBatch(const DeclarationMatcher &FunctionDeclMatcher,
+      const DeclarationMatcher &VarDeclMatcher,
+      const StatementMatcher &RefExprMatcher);
+  bool canMatchConcurrently(ASTContext &Ctx);
+  void matchConcurrently(ASTContext &Ctx);
+  void matchStreamed(const std::vector<Decl*> &Decls);
+  void applyRenames(const std::vector<Rename> &Renames);
+  bool addEdit(SourceLocation Loc, std::string Text);
+  void holdOutput(const DeclGroupRef &DG);
+  void flushOutput(SourceLocation End);
+  void writeOutput();
+  void writeReports(ASTContext &Ctx);
+  void addMemoryMetrics(ASTContext &Ctx);
+
+  // Declared first, the trace for -time-trace is written once
+  // everything else has been destroyed
+  std::unique_ptr<trace::Session> TraceSession;
+
+  // Set with -metrics-file (see Metrics.hpp), -memory-report adds
+  // the memory of the AST and our containers to the record
+  std::unique_ptr<metrics::Record> TUMetrics;
+  bool MemoryReport;
+
+  // Set with -record (see Replay.hpp)
+  std::unique_ptr<replay::Bundle> Bundle;
+
+  // Set with -skip-bodies (see Skip.hpp)
+  std::unique_ptr<skip::BodyFilter> BodyFilter;
+
+  // Set with -jobs, every worker parses a copy of the TU (see Parallel.hpp)
+  std::shared_ptr<CompilerInvocation> Invocation;
+
+  // Matcher times for -profile-matchers (see Profile.hpp)
+  profile::MatcherProfile Profile;
   MatchFinder Finder;
   AddSuffixMatcher AddSuffixHandler;
   std::vector<std::string> Names;
+
+  // Every matcher forwards to the AddSuffixHandler through a callback
+  // labeled with its batch, e.g. "AddSuffix/VarDecl batch 3"
+  std::vector<std::unique_ptr<profile::LabeledCallback>> Callbacks;
+  unsigned BatchCount = 0;
+
+  // The matchers for each batch of names, rooted at declarations
+  // for use with -jobs (see Parallel.hpp)
+  std::vector<DeclarationMatcher> ChunkMatchers;
+  std::vector<std::string> ChunkLabels;
+
+  // To avoid renaming the same token several times
+  // we maintain a set of all locations which have been modified
+  std::unordered_set<std::string> renamedLocations = 
+	  std::unordered_set<std::string>({});
+
+  // The Rewriter is only used with -stream, the renames in the main file
+  // are otherwise written as edits of the original buffer (see Output.hpp)
+  Rewriter AddSuffixRewriter;
+  std::vector<output::Edit> Edits;
+  // NOTE: The matchers already know *what* name to search for 
+  // because they _matched_ an expression that corresponds to
+  // the command line arguments.
   std::string Suffix;
+  unsigned Jobs;
+
+  // With -stream, the rewritten main file is written up to the end of
+  // every top-level declaration once it has been matched. Nothing is
+  // written past the first declaration with templates (HeldOffset), their
+  // instantiations can add renames until the end of the TU.
+  bool Stream;
+  std::string ProfileDir;
+  stream::DeclTracker StreamTracker;
+  unsigned FlushedOffset = 0;
+  unsigned HeldOffset = UINT_MAX;
+  ASTContext* Ctx = nullptr;
 };
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef Plugins_Analysis_H
+#define Plugins_Analysis_H
+
+#include "clang/Tooling/Core/Replacement.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+#include "Parallel.hpp"
+
+//-----------------------------------------------------------------------------
+// Library interface (libPluginAnalysis.a)
+// The analyses of both plugins for an ASTContext that has already been
+// built, e.g. by an in-process driver with ClangTool or ASTUnit. The results
+// are returned rather than written to ARG_STATES_OUT_DIR or stdout and
+// nothing is read from the environment.
+//
+// Every call only uses the given ASTContext and the state it creates itself,
+// calls for different ASTContexts may run concurrently. The log level (see
+// Log.hpp) is the only process-wide setting, it stays at 'error' unless
+// logging::init() is called.
+//-----------------------------------------------------------------------------
+namespace analysis {
+  struct ArgStatesResult {
+    std::string symbolName;
+    // One entry for every parameter of the symbol, empty if the symbol
+    // is never called in the TU
+    std::vector<ArgState> argumentStates;
+    // Owns the STR states of 'argumentStates', the states do not reference
+    // the AST (see ArgState::detachIds())
+    StringPool pool;
+
+    /// Write the JSON object that the plugin writes for the symbol
+    void write(std::ostream &f, const ArgStatesOptions &options) const;
+  };
+
+  using ArgStatesResults = std::vector<ArgStatesResult>;
+
+  /// Run the ArgStates analysis for each symbol, the result for
+  /// symbols[i] is at index i. The options that control the output of the
+  /// plugin (-jobs, -stream, -profile-matchers, -metrics-file) are ignored,
+  /// every symbol is matched serially on the calling thread.
+  ArgStatesResults analyzeArgStates(clang::ASTContext &ctx,
+      const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options);
+
+  /// Like analyzeArgStates() but the top-level declarations are matched on
+  /// options.jobs threads as by the plugin (see Parallel.hpp), 'factory'
+  /// parses the copy of the TU for each additional thread. The results are
+  /// the same as those of a serial run.
+  ArgStatesResults analyzeArgStates(clang::ASTContext &ctx,
+      const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options, const parallel::ContextFactory &factory);
+
+  /// The edits that AddSuffix makes to the main file of the TU: every
+  /// declaration of and reference to one of the names gets 'suffix'
+  /// appended. Locations inside macro expansions and in other files
+  /// (e.g. headers) are skipped as they are by the plugin.
+  clang::tooling::Replacements computeRenames(clang::ASTContext &ctx,
+      const std::vector<std::string> &names, llvm::StringRef suffix);
+}
+
+#endif
@@ -22,6 +22,15 @@
 //  The params which are only used with finite values as arguments can
 //  be restricted during harness generation.
 //
+//  With -int-ranges, runs of consecutive INT values are written as
+//  inclusive [first, last] pairs, e.g. "flags": [ 0, [4, 9], 12 ].
+//  The -max-int-ranges <n> option bounds the number of such runs by
+//  joining the closest ones, which over-approximates the states. It
+//  implies -int-ranges since a joined run can span billions of values.
+//
+//  With -params <list>, e.g. -params 'option,2', only the given parameters
+//  (by name or index) are analyzed and written to the output.
+//
 //  Note that the argument names in EUF are derived
 //  from calls (not declarations) so it is integral that parameters in
 //  the output from the plugin follow the call order.
@@ -32,45 +41,178 @@
 //
 
 #include "Base.hpp"
+#include "Metrics.hpp"
+#include "Parallel.hpp"
+#include "Profile.hpp"
+#include "Replay.hpp"
+#include "Skip.hpp"
+#include "Stream.hpp"
+#include "Trace.hpp"
+
+//-----------------------------------------------------------------------------
+// Output (WriteJson.cpp)
+//-----------------------------------------------------------------------------
+/// Write the states of one det() argument as a comma separated list
+void writeStates(const ArgState &argState, std::ostream &f, bool intRanges,
+    const StringPool &pool);
+
+/// Write the JSON object for all arguments of a symbol
+void writeArgStates(std::ostream &f, const std::string &symbolName,
+    const std::vector<ArgState> &argumentStates,
+    const ArgStatesOptions &options, const StringPool &pool);
 
 //-----------------------------------------------------------------------------
 // First pass:
 // In the first pass we will determine every call site to
 // a changed function and what arguments the invocations use
 //-----------------------------------------------------------------------------
-class FirstPassMatcher : public MatchFinder::MatchCallback {
+class FirstPassMatcher {
 public:
-  explicit FirstPassMatcher() {}
-  // Defines what types of nodes we we want to match
-  void run(const MatchFinder::MatchResult &) override;
-  void onEndOfTranslationUnit() override {};
+  explicit FirstPassMatcher(const ArgStatesOptions &options, StringPool &pool)
+    : options(options), pool(pool) {}
+
+  // One handler for each of the matchers in the first pass
+  void handleAnyMatch(const MatchFinder::MatchResult &);
+  void handleRefMatch(const MatchFinder::MatchResult &);
+  void handleIntMatch(const MatchFinder::MatchResult &);
+  void handleStrMatch(const MatchFinder::MatchResult &);
+  void handleChrMatch(const MatchFinder::MatchResult &);
+  void handleUnaryMatch(const MatchFinder::MatchResult &);
+
+  /// The basename of the file of the last matched call, read while
+  /// the AST is still alive. Empty if nothing was matched.
+  std::string getFilename();
 
   std::vector<ArgState> argumentStates;
-  std::string filename;
+
+  // Every matched call and whether it is a copy of a call that has already
+  // been handled (see isDuplicate()), also counted for -metrics-file
+  llvm::DenseMap<const CallExpr*, bool> callSites;
+  uint64_t duplicateMatches = 0;
 private:
-  void getCallPath(DynTypedNode &parent, std::string bindName,
-    std::vector<DynTypedNode> &callPath);
-  void handleLiteralMatch(variants value,
+  const ArgStatesOptions &options;
+  StringPool &pool;
+
+  const CallExpr* beginMatch(const MatchFinder::MatchResult &result);
+  bool isDuplicate(const CallExpr* call, const Stmt* node);
+  void addSpelling(llvm::FoldingSetNodeID &id, SourceLocation loc);
+  void getCallPath(const DynTypedNode &parent);
+  void handleLiteralMatch(const variants &value,
     StateType matchedType, const CallExpr* call, const Expr* matchedExpr);
-  std::tuple<std::string,int> getParam(const CallExpr* matchedCall,
-   std::vector<DynTypedNode>& callPath,
-   const char* bindName);
+  std::tuple<StringRef,int> getParam(const CallExpr* matchedCall,
+   const Expr* matchedExpr);
 
   SourceManager* srcMgr;
-  BoundNodes::IDToNodeMap nodeMap;
+  SourceLocation lastCallLoc;
+
+  // The path from a match up to its call expression, this buffer is reused
+  // for every match in the TU so that no new allocation is needed once it
+  // has grown to the depth of the deepest argument
+  std::vector<DynTypedNode> callPath;
+
+  // The spelling and structure of every handled call by hash, the keys
+  // are allocated from 'callKeys' (see isDuplicate())
+  llvm::DenseMap<unsigned, llvm::SmallVector<llvm::FoldingSetNodeIDRef, 1>>
+    seenCalls;
+  llvm::BumpPtrAllocator callKeys;
 
   // Holds contextual information about the AST, this allows
   // us to determine e.g. the parents of a matched node
   ASTContext* ctx;
 };
 
+// Each matcher is given its own callback object so that the kind of match
+// is known from the callback that is invoked, rather than from probing the
+// bound nodes of every result. The label identifies the matcher in the
+// output of -profile-matchers.
+class FirstPassCallback : public MatchFinder::MatchCallback {
+public:
+  using Handler = void (FirstPassMatcher::*)(const MatchFinder::MatchResult &);
+
+  FirstPassCallback(FirstPassMatcher &matcher, Handler handler,
+    const char* label)
+    : matcher(matcher), handler(handler), label(label) {}
+
+  void run(const MatchFinder::MatchResult &result) override {
+    this->matches++;
+    (this->matcher.*handler)(result);
+  }
+  StringRef getID() const override { return this->label; }
+  uint64_t getMatches() const { return this->matches; }
+
+private:
+  FirstPassMatcher &matcher;
+  Handler handler;
+  const char* label;
+  uint64_t matches = 0;
+};
+
+/// The results of a first pass that no longer reference the AST it was run
+/// on: string states are IDs in the pool of the pass and the remaining ids
+/// are detached (see ArgState::detachIds())
+struct FirstPassResult {
+  std::vector<ArgState> argumentStates;
+  std::string filename;
+  uint64_t callSites = 0;
+  size_t callSitesMemory = 0;
+  uint64_t duplicateMatches = 0;
+  profile::MatcherProfile profile;
+};
+
 class FirstPassASTConsumer : public ASTConsumer {
 public:
-  FirstPassASTConsumer(std::string symbolName);
+  // With 'matchDecls', the matchers are rooted at declarations and
+  // only match within the declarations given to matchChunk()
+  FirstPassASTConsumer(std::string symbolName,
+    const ArgStatesOptions &options, StringPool &pool,
+    bool matchDecls = false);
   void HandleTranslationUnit(ASTContext &ctx) override ;
+  void matchChunk(parallel::Chunk chunk, ASTContext &ctx);
+  void matchScope(const std::vector<Decl*> &decls, ASTContext &ctx);
+
+  /// Move the results of the pass into 'out', the pass must not be
+  /// used afterwards. Must be called while the AST is alive.
+  void detach(FirstPassResult &out);
+
+  /// Run the first pass with one FirstPassASTConsumer for every chunk of
+  /// top-level declarations on options.jobs threads (see Parallel.hpp).
+  /// Each chunk collects strings into a pool of its own and is detached
+  /// from the AST it was matched in on the thread that matched it,
+  /// merge(result, pool) is called for every chunk in chunk order.
+  static void matchConcurrently(ASTContext &ctx,
+    const std::string &symbolName, const ArgStatesOptions &options,
+    parallel::ContextFactory factory,
+    const std::function<void(FirstPassResult&, const StringPool&)> &merge);
+
+  // The callback for each matcher of the first pass
+  struct Callbacks {
+    MatchFinder::MatchCallback* any;
+    MatchFinder::MatchCallback* ref;
+    MatchFinder::MatchCallback* intLiteral;
+    MatchFinder::MatchCallback* strLiteral;
+    MatchFinder::MatchCallback* chrLiteral;
+    MatchFinder::MatchCallback* unary;
+  };
+
+  /// Add the matchers of the first pass to 'finder', also used by the
+  /// benchmarks to record and replay the matches of a TU
+  static void addMatchers(MatchFinder &finder, const std::string &symbolName,
+    const ArgStatesOptions &options, bool matchDecls,
+    const Callbacks &callbacks);
+
+  /// Add the matcher times and match counts of this pass to 'out'
+  void addProfile(profile::MatcherProfile &out) const;
 
   FirstPassMatcher matchHandler;
 private:
+  FirstPassCallback anyCallback;
+  FirstPassCallback refCallback;
+  FirstPassCallback intCallback;
+  FirstPassCallback strCallback;
+  FirstPassCallback chrCallback;
+  FirstPassCallback unaryCallback;
+
+  profile::MatcherProfile profile;
   MatchFinder finder;
 };
 
@@ -114,16 +256,60 @@ private:
 //-----------------------------------------------------------------------------
 class ArgStatesASTConsumer : public ASTConsumer {
 public:
-  ArgStatesASTConsumer(std::string symbolName) ;
+  ArgStatesASTConsumer(std::string symbolName, ArgStatesOptions options,
+      std::unique_ptr<replay::Bundle> bundle = nullptr,
+      std::unique_ptr<skip::BodyFilter> bodyFilter = nullptr,
+      std::shared_ptr<CompilerInvocation> invocation = nullptr);
   ~ArgStatesASTConsumer();
+  void Initialize(ASTContext &ctx) override;
+  bool HandleTopLevelDecl(DeclGroupRef group) override;
+  void HandleInlineFunctionDefinition(FunctionDecl *decl) override;
   void HandleTranslationUnit(ASTContext &ctx) override;
+  bool shouldSkipFunctionBody(Decl *decl) override;
 
 private:
+  void checkParams(ASTContext &ctx);
+  bool canMatchConcurrently(ASTContext &ctx);
+  void runFirstPassConcurrently(ASTContext &ctx);
+  void finishStream();
+  void writeProfile(ASTContext &ctx);
+  void addMetrics(const FirstPassMatcher &handler);
+  void addMetrics(const FirstPassResult &result);
+  void addStateMetrics();
+  void addMemoryMetrics(ASTContext &ctx);
   void dumpArgStates();
   std::string getOutputPath();
+
+  // Declared first, the trace is written after the output
+  std::unique_ptr<trace::Session> traceSession;
   std::string symbolName;
   std::string filename;
   std::vector<ArgState> argumentStates;
+  ArgStatesOptions options;
+
+  // Owns the string states, these outlive the AST since the output is
+  // written when the consumer is destroyed
+  StringPool pool;
+
+  // Matcher times for -profile-matchers, collected from every first pass
+  profile::MatcherProfile profile;
+
+  // Set with -metrics-file, written when the consumer is destroyed
+  std::unique_ptr<metrics::Record> tuMetrics;
+
+  // Set with -record, written once the TU has been parsed
+  std::unique_ptr<replay::Bundle> bundle;
+
+  // Set with -skip-bodies
+  std::unique_ptr<skip::BodyFilter> bodyFilter;
+
+  // Set with -jobs, every worker parses a copy of the TU (see Parallel.hpp)
+  std::shared_ptr<CompilerInvocation> invocation;
+
+  // With -stream, the first pass is fed one declaration at a time
+  std::unique_ptr<FirstPassASTConsumer> streamPass;
+  stream::DeclTracker streamTracker;
+  ASTContext* ctx = nullptr;
 };
 
 #endif
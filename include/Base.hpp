@@ -5,32 +5,38 @@
 #include "clang/AST/ExprCXX.h"
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "clang/AST/ASTConsumer.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
-#include <set>
 #include <variant>
 #include <tuple>
+#include <optional>
+
+#include "Domains.hpp"
+#include "FlatSet.hpp"
+#include "Log.hpp"
+#include "StringPool.hpp"
 
 
 #define OUTPUT_DIR_ENV "ARG_STATES_OUT_DIR"
-#define DEBUG_ENV "DEBUG_AST"
 #define INDENT "  "
 
-#define PRINT_ERR(msg)                              llvm::errs() << \
-                            "\033[31m!>\033[0m " << msg << "\n"
-#define PRINT_WARN(msg) if (getenv(DEBUG_ENV)!=NULL) llvm::errs() << \
-                            "\033[33m!>\033[0m " << msg << "\n"
-#define PRINT_INFO(msg) if (getenv(DEBUG_ENV)!=NULL) llvm::errs() << \
-                            "\033[34m!>\033[0m " << msg << "\n"
 typedef unsigned uint;
-typedef std::variant<unsigned int,uint64_t,std::string> variants;
+// String values reference the AST and are only valid for the current TU,
+// they are interned into a StringPool when they are recorded
+typedef std::variant<unsigned int,uint64_t,llvm::StringRef> variants;
 
 //-----------------------------------------------------------------------------
 // Argument state structures
@@ -40,22 +46,214 @@ enum StateType {
   CHR, INT, STR, UNARY, NONE
 };
 
+//-----------------------------------------------------------------------------
+// Parameters selected with -params, given as a comma separated list of
+// names and/or indices, e.g. 'option,2'
+//-----------------------------------------------------------------------------
+struct ParamSelection {
+  std::vector<std::string> names;
+  std::vector<uint> indices;
+
+  bool empty() const {
+    return names.empty() && indices.empty();
+  }
+
+  bool contains(llvm::StringRef name, uint index) const {
+    return std::find(indices.begin(), indices.end(), index) != indices.end() ||
+           (!name.empty() &&
+            std::find(names.begin(), names.end(), name) != names.end());
+  }
+
+  /// The entries that select none of the parameters of 'decl', e.g. a
+  /// misspelled name or an index past the last parameter. Names are
+  /// taken from the first declaration, like in the matchers.
+  std::vector<std::string> getUnmatched(const clang::FunctionDecl* decl)
+   const {
+    const auto* firstDecl = decl->getFirstDecl();
+    std::vector<std::string> unmatched;
+
+    for (const auto &name : names) {
+      const auto params = firstDecl->parameters();
+      if (std::none_of(params.begin(), params.end(),
+          [&](const clang::ParmVarDecl* param) {
+            return param->getName() == name;
+          })) {
+        unmatched.push_back(name);
+      }
+    }
+    for (const auto index : indices) {
+      if (index >= firstDecl->getNumParams()) {
+        unmatched.push_back(std::to_string(index));
+      }
+    }
+    return unmatched;
+  }
+
+  /// Returns false if the list contains an empty entry
+  bool parse(llvm::StringRef list) {
+    llvm::SmallVector<llvm::StringRef, 4> entries;
+    list.split(entries, ',');
+
+    for (auto entry : entries) {
+      entry = entry.trim();
+      uint index;
+      if (entry.empty()) {
+        return false;
+      } else if (!entry.getAsInteger(10, index)) {
+        indices.push_back(index);
+      } else {
+        names.push_back(entry.str());
+      }
+    }
+    return true;
+  }
+};
+
+//-----------------------------------------------------------------------------
+// Options given through -plugin-arg-ArgStates
+//-----------------------------------------------------------------------------
+struct ArgStatesOptions {
+  // -max-int-ranges <n>: Upper bound on the number of disjoint intervals
+  // kept for each INT parameter, 0 means unbounded. Implies -int-ranges.
+  uint maxIntRanges = 0;
+
+  // -int-ranges: Write runs of consecutive INT values as [first, last]
+  // rather than enumerating every value
+  bool intRanges = false;
+
+  // -spelled-only: Only match nodes that are spelled in the source, i.e.
+  // traverse with TK_IgnoreUnlessSpelledInSource. Template instantiations
+  // and implicit nodes are not visited.
+  bool spelledOnly = false;
+
+  // -jobs <n>: Match the top-level declarations of the TU on <n> threads,
+  // every thread but one parses a copy of the TU (see Parallel.hpp)
+  uint jobs = 1;
+
+  // -stream: Match every top-level declaration as soon as it has been
+  // parsed (see Stream.hpp), takes precedence over -jobs
+  bool stream = false;
+
+  // -params <list>: Only match, classify and output the arguments
+  // for these parameters, all parameters are considered if empty
+  ParamSelection params;
+
+  // -profile-matchers <dir>: Write the time spent in each matcher
+  // to a report in <dir> (see Profile.hpp)
+  std::string profileDir;
+
+  // -time-trace <file>: Write the spans of the plugin phases as
+  // trace-event JSON, unless -ftime-trace is given (see Trace.hpp)
+  std::string timeTracePath;
+
+  // -metrics-file <file>: Append counters and phase times for
+  // the TU to <file> (see Metrics.hpp)
+  std::string metricsFile;
+
+  // -memory-report: Add the memory held by the AST, the SourceManager
+  // and the plugin to the metrics of the TU
+  bool memoryReport = false;
+
+  // -skip-bodies: Do not parse function bodies that cannot contain a call
+  // to the symbol (see Skip.hpp)
+  bool skipBodies = false;
+};
+
 struct ArgState {
   bool isNonDet = false;
   StateType type = NONE;
+  // Set once the type has been determined from an argument
+  bool hasType = false;
+
+  // Populated with the (leaf) node of every expr that is passed
+  // to this function parameter in the current TU, nodes are identified
+  // by their address. Numeric IDs (Stmt::getID()) are only computed
+  // for debug output.
+  llvm::DenseSet<const clang::Stmt*> ids;
 
-  // Populated with the (leaf) node ID of every expr that is passed
-  // to this function parameter in the current TU
-  std::set<uint64_t> ids;
+  // With -jobs, the ids of a chunk are replaced with the raw encoding of
+  // their locations before the copy of the TU that the chunk was matched
+  // in is freed, see detachIds(). Locations are the same in every copy.
+  std::vector<uint64_t> detachedIds;
 
-  // We only need one set of states for each Arg
-  // This solution with variant requires C++17
-  // Characters a represented as unsigned int
-  std::set<variants> states;
+  // The states are kept in one domain per value type, only the domain
+  // that corresponds to the StateType of the argument will be populated.
+  // Characters are represented as unsigned int, UNARY values share the
+  // domain of INT values and strings are stored as StringPool IDs.
+  CharDomain chrStates;
+  IntDomain intStates;
+  FlatSet<uint32_t> strStates;
 
   // Will be empty for parameters without names in their declaration, e.g.
   //  foo(int, char*)
   std::string paramName;
+
+  bool addState(const variants &value, StringPool &pool,
+   uint maxIntRanges = 0) {
+    if (const auto chr = std::get_if<unsigned int>(&value)) {
+      return chrStates.insert(*chr);
+    } else if (const auto integer = std::get_if<uint64_t>(&value)) {
+      return intStates.insert(*integer, maxIntRanges);
+    } else {
+      return strStates.insert(pool.intern(std::get<llvm::StringRef>(value)));
+    }
+  }
+
+  /// Merge the states collected for the same parameter in another part of the
+  /// TU, the string states of 'other' are IDs in 'otherPool'
+  void merge(const ArgState &other, const StringPool &otherPool,
+   StringPool &pool, uint maxIntRanges = 0) {
+    isNonDet = isNonDet || other.isNonDet;
+    if (other.hasType) {
+      type = other.type;
+      hasType = true;
+    }
+    if (paramName.empty()) {
+      paramName = other.paramName;
+    }
+    ids.insert(other.ids.begin(), other.ids.end());
+    detachedIds.insert(detachedIds.end(), other.detachedIds.begin(),
+        other.detachedIds.end());
+    chrStates.merge(other.chrStates);
+    intStates.merge(other.intStates, maxIntRanges);
+    for (const auto id : other.strStates) {
+      strStates.insert(pool.intern(otherPool.get(id)));
+    }
+  }
+
+  /// Replace the nodes in ids[] with their locations, the state does not
+  /// reference the AST afterwards
+  void detachIds() {
+    for (const auto* id : ids) {
+      detachedIds.push_back(id->getBeginLoc().getRawEncoding());
+    }
+    ids = llvm::DenseSet<const clang::Stmt*>();
+  }
+
+  /// The number of arguments that have not been classified as det(),
+  /// attached or not
+  size_t getIdCount() const {
+    return ids.size() + detachedIds.size();
+  }
+
+  /// Approximate number of bytes held by the state, including itself
+  size_t getMemorySize() const {
+    return sizeof(ArgState) + ids.getMemorySize() +
+           detachedIds.capacity() * sizeof(uint64_t) +
+           chrStates.getMemorySize() + intStates.getMemorySize() +
+           strStates.getMemorySize() + paramName.capacity();
+  }
+
+  bool hasState(const variants &value, const StringPool &pool) const {
+    if (const auto chr = std::get_if<unsigned int>(&value)) {
+      return chrStates.count(*chr) > 0;
+    } else if (const auto integer = std::get_if<uint64_t>(&value)) {
+      return intStates.count(*integer) > 0;
+    } else {
+      const auto id = pool.lookup(std::get<llvm::StringRef>(value));
+      return id != StringPool::NoID && strStates.count(id) > 0;
+    }
+  }
 };
 
 using namespace clang;
@@ -0,0 +1,92 @@
+#ifndef ArgStates_Domains_H
+#define ArgStates_Domains_H
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <bitset>
+#include <cstdint>
+
+#include "FlatSet.hpp"
+
+//-----------------------------------------------------------------------------
+// Abstract value domains
+// Compact representations for the states of CHR and INT parameters
+//-----------------------------------------------------------------------------
+
+/// The states of a CHR parameter, plain characters are kept in a bitset
+/// while the (rare) wide character values are kept in a sorted array
+class CharDomain {
+public:
+  bool insert(unsigned value);
+  size_t count(unsigned value) const;
+  void merge(const CharDomain &other);
+
+  size_t size() const { return bits.count() + wide.size(); }
+  bool empty() const { return size() == 0; }
+
+  /// Bytes allocated outside of the object itself
+  size_t getMemorySize() const { return wide.getMemorySize(); }
+
+  /// Invokes fn(value) for every value in ascending order
+  template<typename F>
+  void forEach(F fn) const {
+    for (unsigned i = 0; i < bits.size(); i++) {
+      if (bits.test(i)) {
+        fn(i);
+      }
+    }
+    for (const auto value : wide) {
+      fn(value);
+    }
+  }
+
+private:
+  std::bitset<256> bits;
+  FlatSet<unsigned> wide;
+};
+
+/// The states of an INT parameter, stored as a sorted list of disjoint
+/// intervals where consecutive values are coalesced into one interval.
+///
+/// When a limit is given and the number of intervals exceeds it,
+/// the two neighbouring intervals with the smallest gap between them
+/// are joined. This over-approximates the states (the values in the gap
+/// were never observed) but keeps the domain bounded for parameters that
+/// see thousands of distinct values.
+class IntDomain {
+public:
+  struct Interval {
+    uint64_t first;
+    uint64_t last;
+  };
+
+  /// Returns true if the value was not already part of the domain
+  bool insert(uint64_t value, unsigned maxIntervals = 0);
+  size_t count(uint64_t value) const;
+  void merge(const IntDomain &other, unsigned maxIntervals = 0);
+
+  /// The number of values in the domain (saturates at UINT64_MAX)
+  uint64_t size() const;
+  bool empty() const { return intervals.empty(); }
+
+  /// False if intervals have been joined to respect a limit
+  bool isExact() const { return exact; }
+
+  /// Bytes allocated outside of the object itself
+  size_t getMemorySize() const {
+    return intervals.size() > 4 ? intervals.capacity_in_bytes() : 0;
+  }
+
+  const llvm::SmallVectorImpl<Interval>& getIntervals() const {
+    return intervals;
+  }
+
+private:
+  void coalesce(size_t index);
+  void limit(unsigned maxIntervals);
+
+  llvm::SmallVector<Interval, 4> intervals;
+  bool exact = true;
+};
+
+#endif
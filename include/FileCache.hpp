@@ -0,0 +1,110 @@
+#ifndef Plugins_FileCache_H
+#define Plugins_FileCache_H
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+
+//-----------------------------------------------------------------------------
+// Shared file cache for in-process drivers
+// Every CompilerInstance has a FileManager of its own, the headers of a
+// project are therefore stat'ed and read again for every TU. A Cache is
+// shared by all TUs of a driver and is exposed to each of them through a
+// CachingFileSystem layer on top of its (physical) base file system:
+//
+//  * Stats, including failed lookups along the header search path, are
+//    cached for one batch, newBatch() forgets them
+//  * The contents of every file that is opened are kept (memory-mapped
+//    where possible) and handed out as read-only buffers. Every open stats
+//    the file again, bypassing the cached stats, and the file is read
+//    again if its mtime or size has changed since it was cached.
+//  * newBatch() evicts the contents of files that were not opened during
+//    the batch that just ended, e.g. files that have been deleted
+//
+// Entries are keyed by absolute path, every layer resolves relative paths
+// against its own working directory. The cache can be used from any
+// number of threads, a layer belongs to one CompilerInstance at a time.
+//-----------------------------------------------------------------------------
+namespace filecache {
+  struct Stats {
+    uint64_t statHits = 0;
+    uint64_t statMisses = 0;
+    uint64_t readHits = 0;
+    uint64_t readMisses = 0;
+    uint64_t bytes = 0;
+  };
+
+  class Cache {
+  public:
+    /// Contents are only cached while the total is below 'maxBytes'
+    explicit Cache(uint64_t maxBytes = 1ULL << 30) : maxBytes(maxBytes) {}
+
+    /// Stats from earlier batches are looked up again, files that have
+    /// not been opened since the last call are evicted
+    void newBatch();
+
+    Stats getStats() const;
+
+  private:
+    friend class CachingFileSystem;
+
+    struct FileEntry {
+      llvm::vfs::Status status;
+      // Shared with the buffers that have been handed out, these remain
+      // valid if the entry is replaced or evicted
+      std::shared_ptr<llvm::MemoryBuffer> buffer;
+      // The batch in which the file was last opened
+      std::atomic<uint64_t> lastUsed{0};
+    };
+
+    std::optional<llvm::ErrorOr<llvm::vfs::Status>> lookupStatus(
+        llvm::StringRef path);
+    void storeStatus(llvm::StringRef path,
+        const llvm::ErrorOr<llvm::vfs::Status> &status);
+    std::shared_ptr<llvm::MemoryBuffer> lookupFile(llvm::StringRef path,
+        const llvm::vfs::Status &status);
+    void storeFile(llvm::StringRef path, const llvm::vfs::Status &status,
+        std::shared_ptr<llvm::MemoryBuffer> buffer);
+
+    const uint64_t maxBytes;
+    std::atomic<uint64_t> generation{0};
+
+    mutable std::shared_mutex statMutex;
+    llvm::StringMap<llvm::ErrorOr<llvm::vfs::Status>> stats;
+    mutable std::shared_mutex fileMutex;
+    llvm::StringMap<FileEntry> files;
+    uint64_t bytes = 0;
+
+    std::atomic<uint64_t> statHits{0}, statMisses{0};
+    std::atomic<uint64_t> readHits{0}, readMisses{0};
+  };
+
+  class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+  public:
+    CachingFileSystem(Cache &cache,
+        llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> base);
+
+    llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override;
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+      openFileForRead(const llvm::Twine &path) override;
+
+  private:
+    bool getKey(const llvm::Twine &path, llvm::SmallVectorImpl<char> &key);
+
+    Cache &cache;
+  };
+
+  /// A caching layer over a physical file system with a working directory
+  /// of its own, i.e. one that does not change that of the process
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> createFileSystem(
+      Cache &cache);
+}
+
+#endif
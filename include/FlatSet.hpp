@@ -0,0 +1,70 @@
+#ifndef ArgStates_FlatSet_H
+#define ArgStates_FlatSet_H
+
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------
+// Sorted set kept in one contiguous buffer
+// Most parameters only ever see a handful of distinct values, these fit
+// inline in the object without any heap allocation. Iteration order is the
+// same as for a std::set, i.e. ascending.
+//-----------------------------------------------------------------------------
+template<typename T, unsigned N = 4>
+class FlatSet {
+public:
+  using const_iterator = typename llvm::SmallVector<T,N>::const_iterator;
+
+  bool insert(const T &value) {
+    auto it = std::lower_bound(items.begin(), items.end(), value);
+    if (it != items.end() && *it == value) {
+      return false;
+    }
+    items.insert(it, value);
+    return true;
+  }
+
+  size_t erase(const T &value) {
+    auto it = std::lower_bound(items.begin(), items.end(), value);
+    if (it == items.end() || *it != value) {
+      return 0;
+    }
+    items.erase(it);
+    return 1;
+  }
+
+  size_t count(const T &value) const {
+    return std::binary_search(items.begin(), items.end(), value) ? 1 : 0;
+  }
+
+  /// Insert every value from another set with one linear merge
+  void merge(const FlatSet &other) {
+    if (other.empty()) {
+      return;
+    }
+    llvm::SmallVector<T,N> merged;
+    merged.reserve(items.size() + other.items.size());
+    std::set_union(items.begin(), items.end(),
+                   other.items.begin(), other.items.end(),
+                   std::back_inserter(merged));
+    items = std::move(merged);
+  }
+
+  size_t size() const { return items.size(); }
+  bool empty() const { return items.empty(); }
+  void clear() { items.clear(); }
+
+  /// Bytes allocated outside of the object itself
+  size_t getMemorySize() const {
+    return items.size() > N ? items.capacity_in_bytes() : 0;
+  }
+
+  const_iterator begin() const { return items.begin(); }
+  const_iterator end() const { return items.end(); }
+
+private:
+  llvm::SmallVector<T,N> items;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef Plugins_Log_H
+#define Plugins_Log_H
+
+#include "clang/Basic/SourceLocation.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <optional>
+
+#define DEBUG_ENV "DEBUG_AST"
+
+// Messages above this level are removed at compile time, the default
+// is set by the build type (see src/CMakeLists.txt)
+#ifndef PLUGIN_MAX_LOG_LEVEL
+#define PLUGIN_MAX_LOG_LEVEL 3
+#endif
+
+//-----------------------------------------------------------------------------
+// Logging (-log-level <error|warn|info|trace>)
+// The level is resolved once in ParseArgs(): -log-level if given, otherwise
+// 'trace' if DEBUG_AST is set in the environment and 'error' if not.
+// Checking the level is a relaxed atomic load and the message is only
+// formatted when the level is enabled.
+//
+// Trace messages are emitted for every match. These are not written to
+// stderr directly but into a fixed-size ring buffer that any thread can
+// append to without a lock. A writer claims its slot with a CAS and drops
+// the entry if the slot is taken, by a writer that has wrapped around the
+// buffer or by a flush. Source locations are resolved when the buffer
+// is flushed at the end of the TU, only the most recent entries are kept
+// if it overflows. The entries of a TU that never reaches its end are
+// flushed without locations if the process crashes or exits, e.g. through
+// report_fatal_error().
+//-----------------------------------------------------------------------------
+namespace logging {
+  enum class Level : int { Error = 0, Warn = 1, Info = 2, Trace = 3 };
+
+  static constexpr size_t TRACE_MSG_SIZE = 96;
+
+  extern std::atomic<int> currentLevel;
+
+  inline bool isEnabled(Level level) {
+    return static_cast<int>(level) <=
+           currentLevel.load(std::memory_order_relaxed);
+  }
+
+  bool parseLevel(llvm::StringRef str, Level &level);
+
+  /// Set the level from -log-level, or from DEBUG_AST if not given.
+  /// At 'trace', the trace buffer is also flushed on a crash or exit.
+  void init(std::optional<Level> fromArgs);
+
+  /// Append an entry to the trace buffer, 'type' must be a literal.
+  /// The message is truncated to TRACE_MSG_SIZE bytes.
+  void trace(const char* type, int pass, clang::SourceLocation loc,
+      llvm::StringRef msg);
+
+  /// Write and clear the trace buffer, locations are only resolved if
+  /// a SourceManager is given. May run concurrently with trace() (e.g.
+  /// on a crash), entries that are being written are not included.
+  void flushTraces(const clang::SourceManager* srcMgr);
+}
+
+#define LOG_ENABLED(level) \
+  (static_cast<int>(level) <= PLUGIN_MAX_LOG_LEVEL && logging::isEnabled(level))
+
+#define PRINT_ERR(msg) do { llvm::errs() << \
+                            "\033[31m!>\033[0m " << msg << "\n"; } while (0)
+#define PRINT_WARN(msg) do { if (LOG_ENABLED(logging::Level::Warn)) \
+    llvm::errs() << "\033[33m!>\033[0m " << msg << "\n"; } while (0)
+#define PRINT_INFO(msg) do { if (LOG_ENABLED(logging::Level::Info)) \
+    llvm::errs() << "\033[34m!>\033[0m " << msg << "\n"; } while (0)
+#define PRINT_TRACE(msg) do { if (LOG_ENABLED(logging::Level::Trace)) { \
+    llvm::SmallString<128> _str; llvm::raw_svector_ostream _s(_str); \
+    _s << msg; \
+    logging::trace(nullptr, 0, clang::SourceLocation(), _str); } } while (0)
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef Plugins_Metrics_H
+#define Plugins_Metrics_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
+
+namespace clang {
+  class ASTContext;
+}
+
+#define METRICS_FILE_ENV "PLUGIN_METRICS_FILE"
+
+//-----------------------------------------------------------------------------
+// Metrics (-metrics-file <file>)
+// Counters and the wall time of every phase are recorded for each TU and
+// appended to the metrics file as one line of JSON (NDJSON), e.g.
+//
+//  {"plugin":"ArgStates","labels":{"symbol":"onig_search","tu":"jv.c"},
+//   "counters":{"callSites":4,"det":2,...},
+//   "matches":{"FirstPass/ANY":31,...},"phases":{"first pass":0.0132,...}}
+//
+// Without -metrics-file, the path is read from PLUGIN_METRICS_FILE so that
+// the metrics of a batch run can be collected without changing the
+// invocation of each TU. Every line is written with a single append, lines
+// from concurrent clang processes do not interleave.
+//
+// With -memory-report, the record also has a "memory" object (in bytes):
+//  * ast:         ASTContext::getASTAllocatedMemory()
+//  * sideTables:  ASTContext::getSideTableAllocatedMemory(), record layouts
+//                 and other lazily computed tables
+//  * parentMap:   The growth of the malloc() heap while building the parent
+//                 map, which is built up front when a report is requested.
+//                 Only available with glibc and not with -stream, where
+//                 the map is rebuilt for every declaration.
+//  * sourceManager*: Content caches, data structures and file buffers
+//  * The containers of the plugin (approximate), e.g. argumentStates
+//  * peakRSS:     Peak resident set size of the process so far
+//-----------------------------------------------------------------------------
+namespace metrics {
+  class Record {
+  public:
+    Record(std::string path, llvm::StringRef plugin);
+
+    void setLabel(llvm::StringRef name, llvm::StringRef value);
+    void add(llvm::StringRef counter, uint64_t count = 1);
+    void addMatches(const llvm::StringMap<uint64_t> &matches);
+    void addTime(llvm::StringRef phase, double seconds);
+    void addMemory(llvm::StringRef name, uint64_t bytes);
+
+    /// Append the record as one line to the metrics file
+    bool append() const;
+
+  private:
+    std::string path;
+    std::string plugin;
+    // Ordered maps to give the same key order on every line
+    std::map<std::string, std::string> labels;
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, uint64_t> matches;
+    std::map<std::string, double> phases;
+    std::map<std::string, uint64_t> memory;
+  };
+
+  /// Adds the wall time of a scope to a phase of the record, if any
+  class Phase {
+  public:
+    Phase(Record* record, llvm::StringRef name)
+      : record(record), name(name),
+        start(std::chrono::steady_clock::now()) {}
+    ~Phase() {
+      if (this->record) {
+        const std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - this->start;
+        this->record->addTime(this->name, elapsed.count());
+      }
+    }
+
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+
+  private:
+    Record* record;
+    llvm::StringRef name;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  /// The metrics file given as an argument, or PLUGIN_METRICS_FILE
+  std::string getPath(llvm::StringRef fromArgs);
+
+  /// Bytes currently allocated through malloc(), if the C library says
+  std::optional<uint64_t> getHeapAllocated();
+
+  /// Add the memory held by the AST and the SourceManager
+  void addASTMemory(Record &record, clang::ASTContext &ctx);
+
+  /// Build the parent map of the entire TU and add its size
+  void addParentMapMemory(Record &record, clang::ASTContext &ctx);
+
+  /// Add the peak RSS of the process
+  void addPeakRSS(Record &record);
+}
+
+#endif
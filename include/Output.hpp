@@ -0,0 +1,31 @@
+#ifndef Plugins_Output_H
+#define Plugins_Output_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Edited file output
+// Rather than applying the edits to a copy of the file (e.g. the
+// RewriteBuffer of a Rewriter), the file is written as a sequence of spans:
+// the unchanged text between two edits is taken directly from the buffer
+// of the SourceManager and interleaved with the replacement text. The spans
+// are written with writev(), the only copy of the file is the one made by
+// the kernel.
+//-----------------------------------------------------------------------------
+namespace output {
+  struct Edit {
+    unsigned offset;
+    unsigned length;
+    std::string text;
+  };
+
+  /// Write 'buffer' with the edits applied to 'fd', the edits are sorted
+  /// by offset and edits that overlap a previous one are dropped.
+  /// Returns false with errno set if a write fails.
+  bool writeEdited(int fd, llvm::StringRef buffer, std::vector<Edit> &edits);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef Plugins_Parallel_H
+#define Plugins_Parallel_H
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "llvm/ADT/ArrayRef.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Intra-TU parallel matching (-jobs <n>)
+// The top-level declarations of a TU are split into chunks that are matched
+// concurrently, each with its own MatchFinder. Matchers are rooted at the
+// declarations of a chunk with decl(forEachDescendant(...)) and the results
+// of every chunk are merged in chunk order once all of them are done.
+//
+// An ASTContext cannot be shared between threads, matching and constant
+// evaluation update its state (e.g. DynTypedMatcher::matches() sets the
+// traversal kind of the ParentMapContext). The calling thread matches the
+// ASTContext of the TU, every other worker parses a copy of the TU with a
+// ContextFactory and matches its own copy. The copies are parsed from the
+// file contents of the original SourceManager, SourceLocations are
+// therefore the same in every copy. A worker whose copy differs from the
+// original (e.g. if it fails to parse or lacks function bodies that the
+// original has) does not take any chunks.
+//
+// A copy is freed as soon as its worker runs out of chunks, the results of a
+// chunk must therefore not reference the AST that it was matched in (strings
+// are interned and nodes are replaced with their locations). A worker that
+// starts once the last chunk has been taken does not parse a copy, one that
+// finishes parsing after that frees it right away and has only cost CPU time.
+// Every copy holds about as much memory as the AST of the TU, the number of
+// workers is limited so that all copies together stay below MAX_COPY_MEMORY and
+// a TU that is too large for a single copy is matched serially. Since every
+// worker parses the TU once more, -jobs only pays off for TUs where matching
+// takes longer than parsing.
+//-----------------------------------------------------------------------------
+namespace parallel {
+  using Chunk = llvm::ArrayRef<clang::Decl*>;
+
+  /// Parses a copy of the TU for a worker thread, returns nullptr on failure.
+  /// Invoked concurrently from the worker threads.
+  using ContextFactory = std::function<std::unique_ptr<clang::ASTUnit>()>;
+
+  /// The memory that the copies of the TU may hold at the same time
+  static constexpr uint64_t MAX_COPY_MEMORY = 2ULL << 30;
+
+  /// The number of jobs (at most 'jobs') whose copies of the TU fit into
+  /// MAX_COPY_MEMORY, the calling thread does not need a copy
+  unsigned getMaxJobs(const clang::ASTContext &ctx, unsigned jobs);
+
+  /// Returns false (and the reason) if the TU cannot be matched concurrently
+  /// with 'jobs' jobs
+  bool canMatchConcurrently(clang::ASTContext &ctx, unsigned jobs,
+      std::string &reason);
+
+  /// A factory that parses the TU of 'invocation' again, the files are read
+  /// from 'srcMgr' rather than from disk. The copies always parse every
+  /// function body, whatever the frontend options of 'invocation' say.
+  /// Must be called once the TU has been parsed and on the thread that
+  /// parsed it, the SourceManager has to outlive the factory.
+  ContextFactory reparseFrom(const clang::CompilerInvocation &invocation,
+      const clang::SourceManager &srcMgr);
+
+  /// Build the lazily computed state of the ASTContext that the matchers
+  /// need, this must be done before any worker thread is started
+  void prepareContext(clang::ASTContext &ctx);
+
+  class ChunkRunner {
+  public:
+    ChunkRunner(clang::ASTContext &ctx, unsigned jobs,
+        ContextFactory factory);
+
+    size_t getChunkCount() const { return chunks.size(); }
+
+    /// Invokes fn(index, chunk, ctx) for every chunk on the calling thread
+    /// and 'jobs - 1' worker threads, 'ctx' is the ASTContext that the
+    /// declarations of 'chunk' belong to. 'ctx' may be freed once fn
+    /// returns. Returns once every chunk has been handled.
+    void run(std::function<void(size_t, Chunk, clang::ASTContext&)> fn);
+
+  private:
+    clang::ASTContext &ctx;
+    unsigned jobs;
+    ContextFactory factory;
+    std::vector<clang::Decl*> decls;
+    // The [begin, end) indices into the top-level declarations of a TU
+    std::vector<std::pair<size_t, size_t>> chunks;
+  };
+}
+
+#endif
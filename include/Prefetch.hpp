@@ -0,0 +1,88 @@
+#ifndef Plugins_Prefetch_H
+#define Plugins_Prefetch_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace clang {
+  class SourceManager;
+}
+
+//-----------------------------------------------------------------------------
+// Read-ahead for in-process drivers
+// The files that every TU read are recorded in a DependencyLog, which can be
+// saved and loaded again by the next run. A Prefetcher is given the main
+// file and the recorded dependencies of every TU in the order in which the
+// TUs are scheduled. It asks the kernel to read them ahead of time
+// (posix_fadvise(POSIX_FADV_WILLNEED)) from a thread of its own while the
+// workers are parsing.
+//
+// The prefetcher runs at most 'window' bytes ahead of the TUs that have
+// been started, files shared with an earlier TU are only counted once.
+//-----------------------------------------------------------------------------
+namespace prefetch {
+  class DependencyLog {
+  public:
+    /// The absolute paths of every file loaded by the SourceManager,
+    /// the main file first
+    static std::vector<std::string> collect(
+        const clang::SourceManager &srcMgr);
+
+    void record(llvm::StringRef tu, std::vector<std::string> files);
+    std::vector<std::string> get(llvm::StringRef tu) const;
+
+    /// A JSON object of TU -> files, entries that are already recorded
+    /// are not replaced by those of the file
+    bool load(llvm::StringRef path);
+    bool save(llvm::StringRef path) const;
+
+  private:
+    mutable std::mutex mutex;
+    llvm::StringMap<std::vector<std::string>> files;
+  };
+
+  class Prefetcher {
+  public:
+    explicit Prefetcher(uint64_t window);
+    ~Prefetcher();
+
+    /// Queue the files of the next TU, returns its index
+    size_t enqueue(std::vector<std::string> files);
+
+    /// Called by a worker when it starts on a TU
+    void started(size_t index);
+
+    uint64_t getPrefetchedBytes() const { return prefetchedBytes; }
+
+  private:
+    void run();
+    uint64_t prefetch(const std::string &path);
+
+    const uint64_t window;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<std::vector<std::string>> queue;
+    // The bytes prefetched for each queued TU, released when it is started
+    std::vector<uint64_t> bytes;
+    std::vector<bool> isStarted;
+    size_t next = 0;
+    uint64_t inFlight = 0;
+    bool stopped = false;
+
+    // Only used by the prefetch thread
+    llvm::StringSet<> seen;
+    std::atomic<uint64_t> prefetchedBytes{0};
+    std::thread thread;
+  };
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef Plugins_Profile_H
+#define Plugins_Profile_H
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Matcher profiling (-profile-matchers <dir>)
+// With MatchFinderOptions::CheckProfiling, the MatchFinder records the time
+// spent in every matcher, keyed by the getID() of the callback that the
+// matcher was added with. Every matcher is therefore given a callback with
+// a label of its own, e.g. "FirstPass/ANY" or "AddSuffix/VarDecl batch 3".
+//
+// The times and match counts are written to a JSON report for every TU:
+//  {
+//    "tu": "xmlparse.c",
+//    "matchers": [
+//      { "name": "FirstPass/ANY", "wall": 0.0412, "user": 0.0398,
+//        "system": 0.0011, "matches": 1873 },
+//      ...
+//    ]
+//  }
+// Matchers are sorted by wall time. Times from concurrent matching (-jobs)
+// are summed over all threads.
+//-----------------------------------------------------------------------------
+namespace profile {
+  using clang::ast_matchers::MatchFinder;
+
+  class MatcherProfile {
+  public:
+    MatcherProfile() = default;
+    // The finder options reference the records of this object
+    MatcherProfile(const MatcherProfile&) = delete;
+    MatcherProfile& operator=(const MatcherProfile&) = delete;
+
+    /// Options for a MatchFinder that records into this profile,
+    /// profiling is only enabled if 'enabled' is set
+    MatchFinder::MatchFinderOptions getFinderOptions(bool enabled);
+
+    /// Add the times from the last MatchFinder::matchAST() or match()
+    /// call to the totals, every call overwrites the previous records
+    void collect();
+
+    void addMatches(llvm::StringRef label, uint64_t count);
+    void merge(const MatcherProfile &other);
+
+    /// Match counts are kept even without profiling
+    const llvm::StringMap<uint64_t>& getMatches() const {
+      return this->matches;
+    }
+
+    /// Write the report to <dir>/<stem>.profile.json
+    bool write(llvm::StringRef dir, llvm::StringRef stem,
+        llvm::StringRef tu) const;
+
+  private:
+    llvm::StringMap<llvm::TimeRecord> records;
+    llvm::StringMap<llvm::TimeRecord> totals;
+    llvm::StringMap<uint64_t> matches;
+  };
+
+  /// Forwards the matches of one matcher to a shared callback under
+  /// a label of its own
+  class LabeledCallback : public MatchFinder::MatchCallback {
+  public:
+    LabeledCallback(std::string label, MatchFinder::MatchCallback* target)
+      : label(std::move(label)), target(target) {}
+
+    void run(const MatchFinder::MatchResult &result) override {
+      this->matches++;
+      this->target->run(result);
+    }
+    llvm::StringRef getID() const override { return this->label; }
+    uint64_t getMatches() const { return this->matches; }
+
+  private:
+    std::string label;
+    MatchFinder::MatchCallback* target;
+    uint64_t matches = 0;
+  };
+
+  /// The basename of the main file of the TU
+  std::string getTUName(const clang::SourceManager &srcMgr);
+}
+
+#endif
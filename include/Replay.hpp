@@ -0,0 +1,70 @@
+#ifndef Plugins_Replay_H
+#define Plugins_Replay_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+#include <vector>
+
+namespace clang {
+  class CompilerInstance;
+  class SourceManager;
+}
+
+//-----------------------------------------------------------------------------
+// Record and replay (-record <dir>)
+// Everything needed to rerun the plugin on one TU offline is written to
+//  <dir>/<plugin>_<tu>.<pid>.tar
+// once the TU has been parsed:
+//  files/<path>   Every file that was read, as seen by clang, i.e. the
+//                 expanded source and headers even if they have since been
+//                 removed or changed
+//  overlay.yaml   A VFS overlay (-ivfsoverlay) that maps the original
+//                 absolute paths to the files above
+//  cc1.args       The cc1 arguments of the TU, one per line, without the
+//                 plugin
+//  plugin.args    The plugin arguments without -record, one per line.
+//                 The -metrics-file, -time-trace and -profile-matchers
+//                 outputs are written below out/ of the extracted bundle,
+//                 as is PLUGIN_METRICS_FILE if it is set
+//  inputs/        Files read by the plugin itself, e.g. the -names-file
+//  replay.sh      Runs clang -cc1 with the above under 'perf record',
+//                 PERF, CLANG and PLUGIN override the defaults
+//
+//  tar xf ArgStates_regexec.c.4711.tar
+//  bash ArgStates_regexec.c.4711/replay.sh
+//-----------------------------------------------------------------------------
+namespace replay {
+  class Bundle {
+  public:
+    /// The cc1 arguments and the plugin path are read from 'CI'
+    Bundle(std::string dir, llvm::StringRef plugin,
+        const std::vector<std::string> &pluginArgs,
+        const clang::CompilerInstance &CI);
+
+    /// Include a file read by the plugin, the path is replaced with the
+    /// copy in the plugin arguments
+    void addPluginInput(llvm::StringRef path);
+
+    /// Write the bundle with every file that the SourceManager has loaded
+    bool write(const clang::SourceManager &srcMgr) const;
+
+  private:
+    std::string getScript(llvm::StringRef base) const;
+
+    std::string dir;
+    std::string plugin;
+    std::string pluginPath;
+    std::vector<std::string> cc1Args;
+    std::vector<std::string> pluginArgs;
+    // Bundle path -> content
+    llvm::StringMap<std::string> inputs;
+  };
+
+  /// The plugin arguments without -record <dir>
+  std::vector<std::string> stripRecordArgs(
+      const std::vector<std::string> &args);
+}
+
+#endif
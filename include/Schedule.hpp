@@ -0,0 +1,59 @@
+#ifndef Plugins_Schedule_H
+#define Plugins_Schedule_H
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Header-locality scheduling for in-process drivers
+// TUs that include the same headers are best parsed one after another by
+// the same worker, the headers are then still in the page cache and in the
+// file cache (see FileCache.hpp). The TUs are clustered by the Jaccard
+// similarity of their recorded dependencies (see Prefetch.hpp):
+//
+//  * Leader clustering: every TU joins the most similar cluster if the
+//    similarity to its first TU is at least 'threshold' and starts a
+//    cluster of its own otherwise. TUs with more dependencies are placed
+//    first. TUs without recorded dependencies form clusters of their own.
+//  * Clusters are assigned to the least loaded worker, largest first. The
+//    cost of a TU is the number of files it reads.
+//
+// Workers take TUs from the front of their own queue and once it is empty,
+// steal from the back of the queue with the most TUs left, i.e. from the
+// cluster that its owner would reach last.
+//-----------------------------------------------------------------------------
+namespace schedule {
+  /// The TU indices of every cluster, in the order to parse them
+  std::vector<std::vector<size_t>> clusterByDependencies(
+      const std::vector<std::vector<std::string>> &dependencies,
+      double threshold = 0.5);
+
+  class WorkQueues {
+  public:
+    /// Assign the clusters to 'workers' queues
+    WorkQueues(const std::vector<std::vector<size_t>> &clusters,
+        const std::vector<size_t> &costs, unsigned workers);
+
+    /// The next TU for 'worker', stolen from another worker if its own
+    /// queue is empty, std::nullopt once all TUs have been handed out
+    std::optional<size_t> next(unsigned worker);
+
+    /// The order in which the TUs are expected to be started, i.e. the
+    /// queues interleaved
+    std::vector<size_t> getExpectedOrder() const;
+
+    size_t getSteals() const;
+
+  private:
+    // The TUs are coarse units of work, one lock for all queues suffices
+    mutable std::mutex mutex;
+    std::vector<std::deque<size_t>> queues;
+    size_t steals = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef Plugins_Skip_H
+#define Plugins_Skip_H
+
+#include "clang/AST/Decl.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Function body skipping (-skip-bodies)
+// Sema asks the consumer through shouldSkipFunctionBody() whether to parse
+// each function body once the declarator has been parsed. The source text
+// of the body is scanned with the raw lexer and the body is only skipped
+// if none of its identifiers is one of the names that the plugin matches.
+// The declaration itself is always kept.
+//
+// The scan sees the tokens as written, a body is therefore kept if:
+//  * An identifier is currently defined as a macro whose replacement
+//    tokens, followed through the nested macros, contain one of the names
+//    or a token paste (##). A body that only uses e.g. NULL is skipped.
+//  * It contains a preprocessor directive, e.g. an #include
+//  * The declaration is spelled in a macro, or the body could extend past
+//    the braces: constructor initializers and function-try-blocks
+//
+// Skipping is only safe when nothing after the plugin needs the bodies,
+// i.e. when the plugin is the main action (-plugin rather than -add-plugin).
+//
+// SkipFunctionBodies is set in the FrontendOptions of the CompilerInstance,
+// i.e. in its shared CompilerInvocation. A copy of the invocation made
+// afterwards inherits it and is parsed without the BodyFilter, which skips
+// every body. The flag only applies to the running compiler: copy the
+// invocation before enable() (as -jobs does) or reset the flag in the copy
+// (see parallel::reparseFrom()).
+//-----------------------------------------------------------------------------
+namespace skip {
+  /// Enable body skipping for the TU, returns false (and the reason) if
+  /// 'plugin' is not the main action. Changes the invocation of 'CI'.
+  bool enable(clang::CompilerInstance &CI, llvm::StringRef plugin,
+      std::string &reason);
+
+  class BodyFilter {
+  public:
+    BodyFilter(clang::Preprocessor &pp, const std::vector<std::string> &names);
+
+    /// Returns true if the body of 'decl' cannot reference any of the names
+    bool shouldSkip(const clang::Decl* decl);
+
+    uint64_t getSkipped() const { return skipped; }
+    uint64_t getParsed() const { return parsed; }
+
+  private:
+    bool canSkip(const clang::FunctionDecl* fn) const;
+    bool isNameMacro(llvm::StringRef name) const;
+    bool canExpandToName(const clang::IdentifierInfo* macro,
+        llvm::SmallPtrSetImpl<const clang::IdentifierInfo*> &visited) const;
+
+    clang::Preprocessor &pp;
+    llvm::StringSet<> names;
+    uint64_t skipped = 0;
+    uint64_t parsed = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef Plugins_Stream_H
+#define Plugins_Stream_H
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclGroup.h"
+#include "llvm/ADT/DenseSet.h"
+
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Streaming analysis (-stream)
+// Declarations are matched as soon as the parser hands them to the
+// consumer through HandleTopLevelDecl() and HandleInlineFunctionDefinition()
+// rather than in one traversal of the TU once parsing has finished.
+//
+// MatchFinder::matchAST() and the parent map only cover the traversal scope
+// of the ASTContext, which is narrowed to the declarations at hand for every
+// match and restored to the entire TU afterwards.
+//
+// Inline method definitions are handed over when the outermost class is
+// complete, before the class itself reaches HandleTopLevelDecl(). These
+// definitions are left out of the scope of the enclosing declaration so
+// that they are not matched twice. Function templates instantiated at the
+// end of the TU are handed over through HandleTopLevelDecl() as well.
+//
+// Matches in such late instantiations are spelled inside of the template,
+// i.e. inside of a declaration that has already been handed over. Output
+// that is written while parsing must not go past a declaration for which
+// hasTemplates() is true.
+//-----------------------------------------------------------------------------
+namespace stream {
+  /// True if the declaration is or contains a templated declaration,
+  /// namespaces, linkage specifications and classes are searched
+  bool hasTemplates(const clang::Decl* decl);
+
+  /// Restricts the traversal scope of the ASTContext to a set of
+  /// declarations for the lifetime of the object
+  class TraversalScope {
+  public:
+    TraversalScope(clang::ASTContext &ctx,
+        const std::vector<clang::Decl*> &decls) : ctx(ctx) {
+      ctx.setTraversalScope(decls);
+    }
+    ~TraversalScope() {
+      ctx.setTraversalScope({ctx.getTranslationUnitDecl()});
+    }
+  private:
+    clang::ASTContext &ctx;
+  };
+
+  class DeclTracker {
+  public:
+    /// The scope to match for an inline method definition
+    std::vector<clang::Decl*> inlineDefinition(clang::FunctionDecl* decl);
+
+    /// The scope to match for a group of top-level declarations, i.e.
+    /// the group without the inline definitions that were already matched
+    std::vector<clang::Decl*> topLevelDecls(clang::DeclGroupRef group);
+
+  private:
+    void collect(clang::Decl* decl, std::vector<clang::Decl*> &scope);
+
+    // Inline definitions matched since the last top-level declaration and
+    // every declaration context that (lexically) contains one of them
+    llvm::DenseSet<const clang::Decl*> matched;
+    llvm::DenseSet<const clang::DeclContext*> containers;
+  };
+}
+
+#endif
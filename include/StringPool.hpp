@@ -0,0 +1,57 @@
+#ifndef ArgStates_StringPool_H
+#define ArgStates_StringPool_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include <cstdint>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+// Interned strings
+// Every distinct string is copied into the pool once and identified by a
+// 32-bit ID from then on. The pool owns its copies, interned strings therefore
+// remain valid after the AST they were read from has been destroyed.
+//
+// A pool is created for every TU (and every chunk with -jobs), the copies
+// are bump-allocated from an arena that is released with the pool rather
+// than allocated one by one.
+//-----------------------------------------------------------------------------
+class StringPool {
+public:
+  static constexpr uint32_t NoID = UINT32_MAX;
+
+  uint32_t intern(llvm::StringRef str) {
+    const auto entry = ids.try_emplace(str, (uint32_t)strings.size());
+    if (entry.second) {
+      strings.push_back(entry.first->getKey());
+    }
+    return entry.first->getValue();
+  }
+
+  /// Returns NoID for strings that have not been interned
+  uint32_t lookup(llvm::StringRef str) const {
+    const auto it = ids.find(str);
+    return it == ids.end() ? NoID : it->getValue();
+  }
+
+  llvm::StringRef get(uint32_t id) const { return strings[id]; }
+
+  size_t size() const { return strings.size(); }
+
+  /// Approximate number of bytes held by the pool, the map entries
+  /// (keys and values) are held by the arena
+  size_t getMemorySize() const {
+    return ids.getNumBuckets() * (sizeof(void*) + sizeof(unsigned)) +
+           strings.capacity() * sizeof(llvm::StringRef) +
+           ids.getAllocator().getTotalMemory();
+  }
+
+private:
+  llvm::StringMap<uint32_t, llvm::BumpPtrAllocator> ids;
+  // References the keys owned by the map, indexed by ID
+  std::vector<llvm::StringRef> strings;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef Plugins_Trace_H
+#define Plugins_Trace_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <string>
+
+//-----------------------------------------------------------------------------
+// Time trace (-time-trace <file>)
+// The phases of both plugins are recorded as llvm::TimeTraceScope spans,
+// which are no-ops unless the time trace profiler is running.
+//
+// When clang is invoked with -ftime-trace the profiler is already running
+// and the spans appear in clang's own trace next to parsing and Sema.
+// Otherwise, -time-trace starts the profiler when the ASTConsumer is
+// created and the Chrome trace-event JSON is written to <file> once the
+// consumer is destroyed. Spans from the -jobs worker threads are not
+// recorded, the profiler only covers the thread that started it.
+//-----------------------------------------------------------------------------
+namespace trace {
+  class Session {
+  public:
+    /// Starts the profiler unless it is already running
+    Session(std::string path, llvm::StringRef procName);
+    /// Writes the trace if this session started the profiler
+    ~Session();
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+  private:
+    std::string path;
+    bool ownsProfiler = false;
+  };
+}
+
+#endif
@@ -13,17 +13,16 @@ namespace util {
 
   // Template functions need to be visible to every TU that uses them and
   // one must therefore have the implementation inside of a header
+  // The location is resolved when the trace buffer is flushed (see Log.hpp)
   template<typename T>
-  void dumpMatch(std::string type, T msg, int pass, SourceManager* srcMgr, 
+  void dumpMatch(const char* type, const T &msg, int pass,
   SourceLocation srcLocation) {
-    if(getenv(DEBUG_ENV)!=NULL) {
-      const auto location = srcMgr->getFileLoc(srcLocation);
-      llvm::errs() << "\033[35m" << pass << "\033[0m: " << type << "> " 
-        << location.printToString(*srcMgr)
-        << " " << msg
-        << "\n";
+    if (LOG_ENABLED(logging::Level::Trace)) {
+      llvm::SmallString<64> str;
+      llvm::raw_svector_ostream s(str);
+      s << msg;
+      logging::trace(type, pass, srcLocation, str);
     }
-    return;
   }
 }
 
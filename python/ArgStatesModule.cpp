@@ -0,0 +1,558 @@
+//==============================================================================
+// DESCRIPTION: argstates (Python extension)
+//
+// Runs the ArgStates analysis in-process for every TU and symbol, the TUs
+// are parsed with ClangTool on a native thread pool while the GIL is
+// released.
+//
+// USAGE:
+//    import argstates
+//    states = argstates.analyze('build', ['src/regexec.c'],
+//                               ['onig_search'], jobs=8)
+//    # { 'src/regexec.c': { 'onig_search': { 'str': [...], ... } } }
+//
+//  The dict for a symbol has the same content as the JSON object that the
+//  plugin writes to <symbol>_<tu>.json, symbols without calls in a TU are
+//  left out just as no file is written for them. Files that fail to parse
+//  are reported in the 'errors' attribute of the raised RuntimeError.
+//
+//  Headers are stat'ed and read once for all TUs and calls through a
+//  process-wide file cache (see FileCache.hpp) unless file_cache=False,
+//  argstates.file_cache_stats() returns its hit counts.
+//
+//  The files read by every TU are recorded (see Prefetch.hpp) and saved to
+//  deps_file if given. With prefetch=True, the recorded files of the TUs
+//  are read ahead of the workers, at most prefetch_window bytes ahead.
+//  With cluster=True, TUs with similar recorded dependencies are parsed
+//  by the same worker (see Schedule.hpp).
+//==============================================================================
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "Analysis.hpp"
+#include "FileCache.hpp"
+#include "Prefetch.hpp"
+#include "Schedule.hpp"
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace clang;
+
+// Set by CMake, the Python interpreter is not installed next to the
+// builtin headers of clang (stddef.h etc.)
+#ifndef CLANG_RESOURCE_DIR
+#define CLANG_RESOURCE_DIR ""
+#endif
+
+// Shared by every analyze() call, the stats of a call are not reused by
+// the next one and contents are read again if a file has changed
+static filecache::Cache fileCache;
+
+// The files read by every TU that has been analyzed, or loaded from a
+// deps_file, keyed by the absolute path of the main file
+static prefetch::DependencyLog dependencies;
+
+//-----------------------------------------------------------------------------
+// Analysis
+//-----------------------------------------------------------------------------
+struct TUResult {
+  std::string file;
+  // The absolute path of the main file
+  std::string key;
+  analysis::ArgStatesResults results;
+  bool ok = false;
+};
+
+struct DriverOptions {
+  std::string resourceDir;
+  unsigned jobs = 0;
+  bool useFileCache = true;
+  bool prefetch = true;
+  uint64_t prefetchWindow = 256ULL << 20;
+  bool cluster = true;
+};
+
+class AnalyzeAction : public ASTFrontendAction {
+public:
+  AnalyzeAction(TUResult &result, const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options)
+    : result(result), symbols(symbols), options(options) {}
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &,
+      StringRef) override {
+    return std::make_unique<Consumer>(*this);
+  }
+
+private:
+  class Consumer : public ASTConsumer {
+  public:
+    explicit Consumer(AnalyzeAction &action) : action(action) {}
+
+    void HandleTranslationUnit(ASTContext &ctx) override {
+      action.result.results = analysis::analyzeArgStates(ctx, action.symbols,
+          action.options);
+      dependencies.record(action.result.key,
+          prefetch::DependencyLog::collect(ctx.getSourceManager()));
+    }
+
+  private:
+    AnalyzeAction &action;
+  };
+
+  TUResult &result;
+  const std::vector<std::string> &symbols;
+  const ArgStatesOptions &options;
+};
+
+class AnalyzeActionFactory : public tooling::FrontendActionFactory {
+public:
+  AnalyzeActionFactory(TUResult &result,
+      const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options)
+    : result(result), symbols(symbols), options(options) {}
+
+  std::unique_ptr<FrontendAction> create() override {
+    return std::make_unique<AnalyzeAction>(result, symbols, options);
+  }
+
+private:
+  TUResult &result;
+  const std::vector<std::string> &symbols;
+  const ArgStatesOptions &options;
+};
+
+/// The absolute path of the main file of the first compile command for
+/// 'file', which is also how the file is named by its SourceManager
+static std::string getKey(const tooling::CompilationDatabase &db,
+    const std::string &file) {
+  llvm::SmallString<256> path(file);
+  const auto commands = db.getCompileCommands(file);
+  if (!commands.empty()) {
+    path = commands.front().Filename;
+    if (llvm::sys::path::is_relative(path)) {
+      path = commands.front().Directory;
+      llvm::sys::path::append(path, commands.front().Filename);
+    }
+  }
+  llvm::sys::fs::make_absolute(path);
+  llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+  return path.str().str();
+}
+
+/// Parse one file with its own ClangTool, the workers only share the
+/// (read-only) compilation database and the file cache with each other.
+/// ClangTool changes the working directory of its file system to that of
+/// the compile command, every tool therefore needs a file system that is
+/// not linked to the working directory of the process.
+static void analyzeFile(const tooling::CompilationDatabase &db,
+    TUResult &result, const std::vector<std::string> &symbols,
+    const ArgStatesOptions &options, const DriverOptions &driver) {
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs;
+  if (driver.useFileCache) {
+    fs = filecache::createFileSystem(fileCache);
+  } else {
+    fs = llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>(
+        llvm::vfs::createPhysicalFileSystem().release());
+  }
+  tooling::ClangTool tool(db, {result.file},
+      std::make_shared<PCHContainerOperations>(), fs);
+  tool.setPrintErrorMessage(false);
+  if (!driver.resourceDir.empty()) {
+    tool.appendArgumentsAdjuster(tooling::getInsertArgumentAdjuster(
+          {"-resource-dir", driver.resourceDir},
+          tooling::ArgumentInsertPosition::END));
+  }
+  AnalyzeActionFactory factory(result, symbols, options);
+  result.ok = tool.run(&factory) == 0;
+}
+
+/// Schedule the files on one queue per worker (see Schedule.hpp), TUs with
+/// similar recorded dependencies are parsed by the same worker with
+/// 'cluster' and the files are otherwise dealt out in order
+static void analyzeFiles(const tooling::CompilationDatabase &db,
+    std::vector<TUResult> &results, const std::vector<std::string> &symbols,
+    const ArgStatesOptions &options, const DriverOptions &driver) {
+  std::vector<std::vector<std::string>> tuDependencies;
+  std::vector<size_t> costs;
+  for (const auto &result : results) {
+    tuDependencies.push_back(dependencies.get(result.key));
+    costs.push_back(std::max<size_t>(tuDependencies.back().size(), 1));
+  }
+
+  std::vector<std::vector<size_t>> clusters;
+  if (driver.cluster) {
+    clusters = schedule::clusterByDependencies(tuDependencies);
+  } else {
+    for (size_t i = 0; i < results.size(); i++) {
+      clusters.push_back({i});
+    }
+  }
+  const unsigned workers = std::min<size_t>(
+      llvm::hardware_concurrency(driver.jobs).compute_thread_count(),
+      std::max<size_t>(results.size(), 1));
+  schedule::WorkQueues queues(clusters, costs, workers);
+
+  // The prefetcher follows the expected start order of the TUs
+  std::unique_ptr<prefetch::Prefetcher> prefetcher;
+  std::vector<size_t> prefetchIndex(results.size());
+  if (driver.prefetch) {
+    prefetcher = std::make_unique<prefetch::Prefetcher>(driver.prefetchWindow);
+    for (const auto i : queues.getExpectedOrder()) {
+      auto files = std::move(tuDependencies[i]);
+      if (files.empty()) {
+        files.push_back(results[i].key);
+      }
+      prefetchIndex[i] = prefetcher->enqueue(std::move(files));
+    }
+  }
+
+  std::vector<std::thread> threads;
+  for (unsigned worker = 0; worker < workers; worker++) {
+    threads.emplace_back([&, worker]() {
+      while (const auto i = queues.next(worker)) {
+        if (prefetcher) {
+          prefetcher->started(prefetchIndex[*i]);
+        }
+        analyzeFile(db, results[*i], symbols, options, driver);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Conversion to Python objects
+// The same values as writeStates() and writeArgStates() (WriteJson.cpp)
+//-----------------------------------------------------------------------------
+/// Append a new reference to 'list' and release it
+static bool appendNew(PyObject* list, PyObject* item) {
+  if (item == nullptr) {
+    return false;
+  }
+  const int err = PyList_Append(list, item);
+  Py_DECREF(item);
+  return err == 0;
+}
+
+/// Set a new reference in 'dict' and release it
+static bool setNew(PyObject* dict, PyObject* key, PyObject* value) {
+  if (key == nullptr || value == nullptr) {
+    Py_XDECREF(key);
+    Py_XDECREF(value);
+    return false;
+  }
+  const int err = PyDict_SetItem(dict, key, value);
+  Py_DECREF(key);
+  Py_DECREF(value);
+  return err == 0;
+}
+
+static PyObject* fromString(StringRef str) {
+  // String literals are not necessarily valid UTF-8
+  return PyUnicode_DecodeUTF8(str.data(), str.size(), "surrogateescape");
+}
+
+static bool addStates(PyObject* list, const ArgState &argState,
+    bool intRanges, const StringPool &pool) {
+  switch (argState.type) {
+    case INT:
+    case UNARY: {
+      // Joined intervals are always given as ranges, like in writeStates()
+      const bool asRanges = intRanges || !argState.intStates.isExact();
+      for (const auto &interval : argState.intStates.getIntervals()) {
+        if (asRanges && interval.first != interval.last) {
+          PyObject* range = Py_BuildValue("[KK]",
+              (unsigned long long)interval.first,
+              (unsigned long long)interval.last);
+          if (!appendNew(list, range)) {
+            return false;
+          }
+          continue;
+        }
+        for (uint64_t v = interval.first;; v++) {
+          if (!appendNew(list, PyLong_FromUnsignedLongLong(v))) {
+            return false;
+          }
+          if (v == interval.last) {
+            break;
+          }
+        }
+      }
+      return true;
+    }
+    case CHR: {
+      bool ok = true;
+      argState.chrStates.forEach([&](unsigned value) {
+        ok = ok && appendNew(list, PyLong_FromUnsignedLong(value));
+      });
+      return ok;
+    }
+    case STR: {
+      std::vector<StringRef> values;
+      values.reserve(argState.strStates.size());
+      for (const auto id : argState.strStates) {
+        values.push_back(pool.get(id));
+      }
+      std::sort(values.begin(), values.end());
+
+      for (const auto &value : values) {
+        if (!appendNew(list, fromString(value))) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return true;
+  }
+}
+
+static PyObject* toDict(const analysis::ArgStatesResult &result,
+    const ArgStatesOptions &options) {
+  PyObject* params = PyDict_New();
+  if (params == nullptr) {
+    return nullptr;
+  }
+  for (uint i = 0; i < result.argumentStates.size(); i++) {
+    const auto &argState = result.argumentStates[i];
+    if (!options.params.empty() &&
+        !options.params.contains(argState.paramName, i)) {
+      continue;
+    }
+    PyObject* states = PyList_New(0);
+    // nondet() arguments are given an empty list of states
+    if (states != nullptr && !argState.isNonDet &&
+        argState.getIdCount() == 0 &&
+        !addStates(states, argState, options.intRanges, result.pool)) {
+      Py_CLEAR(states);
+    }
+    PyObject* key = argState.paramName.empty() ?
+      PyUnicode_FromString(std::to_string(i).c_str()) :
+      fromString(argState.paramName);
+
+    if (!setNew(params, key, states)) {
+      Py_DECREF(params);
+      return nullptr;
+    }
+  }
+  return params;
+}
+
+static bool toStrings(PyObject* seq, const char* name,
+    std::vector<std::string> &out) {
+  PyObject* fast = PySequence_Fast(seq, name);
+  if (fast == nullptr) {
+    return false;
+  }
+  const Py_ssize_t size = PySequence_Fast_GET_SIZE(fast);
+  for (Py_ssize_t i = 0; i < size; i++) {
+    Py_ssize_t len;
+    const char* str = PyUnicode_AsUTF8AndSize(
+        PySequence_Fast_GET_ITEM(fast, i), &len);
+    if (str == nullptr) {
+      Py_DECREF(fast);
+      return false;
+    }
+    out.emplace_back(str, len);
+  }
+  Py_DECREF(fast);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Module
+//-----------------------------------------------------------------------------
+PyDoc_STRVAR(analyze_doc,
+"analyze(build_dir, files, symbols, jobs=0, int_ranges=False,\n"
+"        max_int_ranges=0, spelled_only=False, params=None,\n"
+"        resource_dir=None, file_cache=True, prefetch=True,\n"
+"        prefetch_window=256 << 20, deps_file=None, cluster=True) -> dict\n"
+"\n"
+"Run ArgStates for every symbol on every file in the compilation\n"
+"database of build_dir and return {file: {symbol: {param: [states]}}}.\n"
+"The keyword arguments correspond to the plugin arguments, jobs=0 uses\n"
+"one thread per core and max_int_ranges > 0 implies int_ranges.");
+
+static PyObject* analyze(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"build_dir", "files", "symbols", "jobs",
+    "int_ranges", "max_int_ranges", "spelled_only", "params",
+    "resource_dir", "file_cache", "prefetch", "prefetch_window", "deps_file",
+    "cluster", nullptr};
+  const char* buildDir;
+  PyObject* filesArg;
+  PyObject* symbolsArg;
+  unsigned jobs = 0;
+  int intRanges = 0;
+  unsigned maxIntRanges = 0;
+  int spelledOnly = 0;
+  const char* params = nullptr;
+  const char* resourceDirArg = nullptr;
+  int useFileCache = 1;
+  int usePrefetch = 1;
+  unsigned long long prefetchWindow = 256ULL << 20;
+  const char* depsFile = nullptr;
+  int cluster = 1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sOO|IpIpzzppKzp",
+        const_cast<char**>(keywords), &buildDir, &filesArg, &symbolsArg,
+        &jobs, &intRanges, &maxIntRanges, &spelledOnly, &params,
+        &resourceDirArg, &useFileCache, &usePrefetch, &prefetchWindow,
+        &depsFile, &cluster)) {
+    return nullptr;
+  }
+
+  std::vector<std::string> files, symbols;
+  if (!toStrings(filesArg, "files must be a sequence", files) ||
+      !toStrings(symbolsArg, "symbols must be a sequence", symbols)) {
+    return nullptr;
+  }
+
+  ArgStatesOptions options;
+  // Like -max-int-ranges, max_int_ranges implies int_ranges
+  options.intRanges = intRanges || maxIntRanges > 0;
+  options.maxIntRanges = maxIntRanges;
+  options.spelledOnly = spelledOnly;
+  if (params != nullptr && !options.params.parse(params)) {
+    PyErr_Format(PyExc_ValueError, "invalid params: '%s'", params);
+    return nullptr;
+  }
+  DriverOptions driver;
+  driver.resourceDir = resourceDirArg ? resourceDirArg : CLANG_RESOURCE_DIR;
+  driver.jobs = jobs;
+  driver.useFileCache = useFileCache;
+  driver.prefetch = usePrefetch;
+  driver.prefetchWindow = prefetchWindow;
+  driver.cluster = cluster;
+
+  std::string err;
+  const auto db = tooling::CompilationDatabase::loadFromDirectory(buildDir,
+      err);
+  if (!db) {
+    PyErr_SetString(PyExc_RuntimeError, err.c_str());
+    return nullptr;
+  }
+
+  std::vector<TUResult> results(files.size());
+  for (size_t i = 0; i < files.size(); i++) {
+    results[i].file = files[i];
+    results[i].key = getKey(*db, files[i]);
+  }
+
+  bool savedDeps = true;
+  Py_BEGIN_ALLOW_THREADS
+  // A missing file is expected on the first run
+  if (depsFile != nullptr) {
+    dependencies.load(depsFile);
+  }
+  fileCache.newBatch();
+  analyzeFiles(*db, results, symbols, options, driver);
+  if (depsFile != nullptr) {
+    savedDeps = dependencies.save(depsFile);
+  }
+  Py_END_ALLOW_THREADS
+
+  if (!savedDeps && PyErr_WarnFormat(PyExc_RuntimeWarning, 1,
+        "failed to write %s", depsFile) < 0) {
+    return nullptr;
+  }
+
+  PyObject* out = PyDict_New();
+  PyObject* errors = PyList_New(0);
+  if (out == nullptr || errors == nullptr) {
+    Py_XDECREF(out);
+    Py_XDECREF(errors);
+    return nullptr;
+  }
+
+  for (const auto &tu : results) {
+    if (!tu.ok) {
+      if (!appendNew(errors, fromString(tu.file))) {
+        goto error;
+      }
+      continue;
+    }
+    PyObject* tuDict = PyDict_New();
+    if (!setNew(out, fromString(tu.file), tuDict)) {
+      goto error;
+    }
+    for (const auto &result : tu.results) {
+      // No file is written by the plugin in this case
+      if (result.argumentStates.empty()) {
+        continue;
+      }
+      if (!setNew(tuDict, fromString(result.symbolName),
+            toDict(result, options))) {
+        goto error;
+      }
+    }
+  }
+
+  if (PyList_GET_SIZE(errors) > 0) {
+    PyObject* exc = PyObject_CallFunction(PyExc_RuntimeError, "s",
+        "failed to parse one or more files");
+    if (exc != nullptr) {
+      PyObject_SetAttrString(exc, "errors", errors);
+      PyObject_SetAttrString(exc, "results", out);
+      PyErr_SetObject(PyExc_RuntimeError, exc);
+      Py_DECREF(exc);
+    }
+    goto error;
+  }
+  Py_DECREF(errors);
+  return out;
+
+error:
+  Py_DECREF(out);
+  Py_DECREF(errors);
+  return nullptr;
+}
+
+PyDoc_STRVAR(file_cache_stats_doc,
+"file_cache_stats() -> dict\n"
+"\n"
+"The hits and misses of the file cache for stats and reads and the\n"
+"number of bytes it holds.");
+
+static PyObject* fileCacheStats(PyObject*, PyObject*) {
+  const auto stats = fileCache.getStats();
+  return Py_BuildValue("{sKsKsKsKsK}",
+      "stat_hits", (unsigned long long)stats.statHits,
+      "stat_misses", (unsigned long long)stats.statMisses,
+      "read_hits", (unsigned long long)stats.readHits,
+      "read_misses", (unsigned long long)stats.readMisses,
+      "bytes", (unsigned long long)stats.bytes);
+}
+
+static PyMethodDef methods[] = {
+  {"analyze", (PyCFunction)(void(*)(void))analyze,
+   METH_VARARGS | METH_KEYWORDS, analyze_doc},
+  {"file_cache_stats", fileCacheStats, METH_NOARGS, file_cache_stats_doc},
+  {nullptr, nullptr, 0, nullptr}
+};
+
+static struct PyModuleDef module = {
+  PyModuleDef_HEAD_INIT,
+  "argstates",
+  "In-process ArgStates analysis, see analyze()",
+  -1,
+  methods
+};
+
+PyMODINIT_FUNC PyInit_argstates(void) {
+  return PyModule_Create(&module);
+}
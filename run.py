@@ -2,7 +2,7 @@
 '''
 This script assumes that clang-plugins is being ran as a submodule in euf
 '''
-import sys
+import sys, os, json
 from pathlib import Path
 from posixpath import expanduser
 
@@ -16,6 +16,10 @@ from src.util import mkdir_p, remove_files_in
 
 QUIET = False
 
+# Both plugins append one line per TU to this file (see include/Metrics.hpp)
+METRICS_FILE = f"{BASE_DIR}/.metrics.ndjson"
+METRICS_SUMMARY = f"{BASE_DIR}/.metrics-summary.json"
+
 # - - - Usb - - -
 #CONFIG.update_from_file(f"{BASE_DIR}/../examples/base_usb.json")
 #TARGET_DIR=f"{expanduser('~')}/Repos/airspy"
@@ -59,6 +63,57 @@ SYMBOL_LIST=[
 #    "ENTROPY_DEBUG",
 #]
 
+def summarize_metrics(path: str, top: int = 5) -> dict:
+    '''
+    Aggregate the per-TU metrics of a run into one summary per plugin:
+    summed counters, matches and phase times along with the slowest TUs.
+    Memory (from -memory-report) is given as the maximum over all TUs.
+    '''
+    summary = {}
+    if not os.path.exists(path):
+        return summary
+
+    with open(path, mode='r', encoding='utf8') as f:
+        for line in f:
+            if not line.strip(): continue
+            record = json.loads(line)
+            plugin = summary.setdefault(record['plugin'], {
+                'tus': 0, 'counters': {}, 'matches': {},
+                'phases': {}, 'memory': {}, 'slowest': []
+            })
+            plugin['tus'] += 1
+
+            for key in ('counters', 'matches', 'phases'):
+                for name, value in record[key].items():
+                    plugin[key][name] = plugin[key].get(name, 0) + value
+            for name, value in record.get('memory', {}).items():
+                plugin['memory'][name] = max(plugin['memory'].get(name, 0), value)
+
+            plugin['slowest'].append({
+                'labels': record['labels'],
+                'time': sum(record['phases'].values())
+            })
+
+    for plugin in summary.values():
+        plugin['slowest'] = sorted(plugin['slowest'],
+                key=lambda tu: tu['time'], reverse=True)[:top]
+
+    return summary
+
+def print_summary(summary: dict):
+    for name, plugin in summary.items():
+        print(f"===> {name}: {plugin['tus']} TU(s) <===")
+        for phase, secs in sorted(plugin['phases'].items(),
+                key=lambda item: item[1], reverse=True):
+            print(f"  {phase:<20} {secs:10.3f} s")
+        for counter, value in sorted(plugin['counters'].items()):
+            print(f"  {counter:<20} {value:10}")
+        for name, value in sorted(plugin['memory'].items()):
+            print(f"  {name:<20} {value / 2**20:10.1f} MiB (max)")
+        for tu in plugin['slowest']:
+            print(f"  slowest: {tu['labels'].get('tu', '?')} "
+                  f"({tu['time']:.3f} s)")
+
 if __name__ == '__main__':
     CONFIG.CLANG_PLUGIN_RUN_STR_LIMIT = 10000
     subdir_tus = get_subdir_tus(TARGET_DIR)
@@ -66,6 +121,11 @@ if __name__ == '__main__':
     mkdir_p(outdir)
     remove_files_in(outdir)
 
+    # Picked up by the plugins in every clang invocation
+    if os.path.exists(METRICS_FILE):
+        os.remove(METRICS_FILE)
+    os.environ["PLUGIN_METRICS_FILE"] = METRICS_FILE
+
     for subdir in subdir_tus.keys():
         if subdir != SOURCE_SUB_DIR: continue
         print(f"===> {subdir} <===")
@@ -76,3 +136,8 @@ if __name__ == '__main__':
             call_arg_states_plugin(sym, outdir, subdir,
                     subdir_tu, quiet=QUIET, setx=True)
             break
+
+    summary = summarize_metrics(METRICS_FILE)
+    with open(METRICS_SUMMARY, mode='w', encoding='utf8') as f:
+        json.dump(summary, f, indent=2)
+    print_summary(summary)
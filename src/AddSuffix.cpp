@@ -21,95 +21,410 @@
 #include "clang/ASTMatchers/ASTMatchers.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendPluginRegistry.h"
+#include "clang/Lex/Lexer.h"
 #include "clang/Tooling/Refactoring/Rename/RenamingAction.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <unordered_set>
+#include <unistd.h>
 
 using namespace clang;
 using namespace ast_matchers;
 
 //-----------------------------------------------------------------------------
-// AddSuffixMatcher - implementation
-// Add the suffix to matched items
+// AddSuffixASTConsumer- implementation
+// https://clang.llvm.org/docs/LibASTMatchersTutorial.html
+// Specifies the node patterns that we want to analyze further in ::run()
 //-----------------------------------------------------------------------------
 
-void AddSuffixMatcher::replaceInDeclMatch(
-  const MatchFinder::MatchResult &result, std::string bindName) {
+void AddSuffixASTConsumer::Initialize(ASTContext &Ctx) {
+  this->Ctx = &Ctx;
+}
+
+bool AddSuffixASTConsumer::HandleTopLevelDecl(DeclGroupRef DG) {
+  if (this->Stream && !DG.isNull()) {
+    this->matchStreamed(this->StreamTracker.topLevelDecls(DG));
+    this->holdOutput(DG);
+    this->flushOutput((*(DG.end() - 1))->getEndLoc());
+  }
+  return true;
+}
 
-    const DeclaratorDecl *node = result.Nodes
-      .getNodeAs<DeclaratorDecl>(bindName);
+void AddSuffixASTConsumer::HandleInlineFunctionDefinition(FunctionDecl *D) {
+  if (this->Stream) {
+    // Not flushed on its own, the rest of the class has not been matched yet
+    this->matchStreamed(this->StreamTracker.inlineDefinition(D));
+  }
+}
+
+void AddSuffixASTConsumer::matchStreamed(const std::vector<Decl*> &Decls) {
+  if (Decls.empty()) {
+    return;
+  }
+  {
+    llvm::TimeTraceScope TimeScope("AddSuffix matchAST");
+    metrics::Phase Phase(TUMetrics.get(), "matchAST");
+    stream::TraversalScope Scope(*this->Ctx, Decls);
+    Finder.matchAST(*this->Ctx);
+    Profile.collect();
+  }
+  this->applyRenames(this->AddSuffixHandler.Renames);
+  this->AddSuffixHandler.Renames.clear();
+}
+
+/// Only called with -skip-bodies, a body is skipped unless it
+/// mentions one of the names
+bool AddSuffixASTConsumer::shouldSkipFunctionBody(Decl *D) {
+  return this->BodyFilter && this->BodyFilter->shouldSkip(D);
+}
 
-    if (node) {
-      auto nodeName = std::string(node->getName().str());
-      this->replaceInMatch(result, bindName, node->getLocation(), nodeName);
+void AddSuffixASTConsumer::HandleTranslationUnit(ASTContext &Ctx) {
+  const auto FlushTraces = llvm::make_scope_exit([&Ctx] {
+    logging::flushTraces(&Ctx.getSourceManager());
+  });
+  if (this->Bundle) {
+    this->Bundle->write(Ctx.getSourceManager());
+  }
+  if (TUMetrics && this->MemoryReport && !this->Stream) {
+    // Built up front to be measured, it is otherwise built on the first match
+    metrics::addParentMapMemory(*TUMetrics, Ctx);
+  }
+  if (this->Stream) {
+    this->writeOutput();
+    this->writeReports(Ctx);
+    return;
+  }
+  if (this->canMatchConcurrently(Ctx)) {
+    this->matchConcurrently(Ctx);
+  } else {
+    {
+      llvm::TimeTraceScope TimeScope("AddSuffix matchAST");
+      metrics::Phase Phase(TUMetrics.get(), "matchAST");
+      Finder.matchAST(Ctx);
+      Profile.collect();
     }
+    this->applyRenames(this->AddSuffixHandler.Renames);
+  }
+  this->writeOutput();
+  this->writeReports(Ctx);
 }
 
-void AddSuffixMatcher::replaceInDeclRefMatch(
-    const MatchFinder::MatchResult &result, std::string bindName) {
+/// Write the -profile-matchers report and the -metrics-file record
+void AddSuffixASTConsumer::writeReports(ASTContext &Ctx) {
+  for (const auto &C : this->Callbacks) {
+    Profile.addMatches(C->getID(), C->getMatches());
+  }
+  const auto TU = profile::getTUName(Ctx.getSourceManager());
 
-    const DeclRefExpr *node = result.Nodes
-      .getNodeAs<DeclRefExpr>(bindName);
-    
-    if (node) {
-      auto nodeName = std::string(node->getDecl()->getName().str());
-      this->replaceInMatch(result, bindName, node->getExprLoc(), nodeName);
+  if (!this->ProfileDir.empty()) {
+    Profile.write(this->ProfileDir, "AddSuffix_" + TU, TU);
+  }
+  if (TUMetrics) {
+    TUMetrics->setLabel("tu", TU);
+    TUMetrics->add("names", this->Names.size());
+    if (this->BodyFilter) {
+      TUMetrics->add("skippedBodies", this->BodyFilter->getSkipped());
+      TUMetrics->add("parsedBodies", this->BodyFilter->getParsed());
+    }
+    TUMetrics->addMatches(Profile.getMatches());
+    if (this->MemoryReport) {
+      this->addMemoryMetrics(Ctx);
     }
+    TUMetrics->append();
+  }
+}
+
+/// Approximate size of the strings in a container, excluding the
+/// std::string objects themselves
+template<typename Container>
+static size_t getStringsSize(const Container &Strings) {
+  size_t Bytes = 0;
+  for (const auto &S : Strings) {
+    // Short strings are stored inline
+    if (S.capacity() > std::string().capacity()) {
+      Bytes += S.capacity() + 1;
+    }
+  }
+  return Bytes;
+}
+
+void AddSuffixASTConsumer::addMemoryMetrics(ASTContext &Ctx) {
+  metrics::addASTMemory(*TUMetrics, Ctx);
+
+  size_t RewriteBytes = 0;
+  for (auto It = AddSuffixRewriter.buffer_begin();
+       It != AddSuffixRewriter.buffer_end(); ++It) {
+    RewriteBytes += It->second.size();
+  }
+  TUMetrics->addMemory("rewriteBuffers", RewriteBytes);
+  TUMetrics->addMemory("edits",
+      this->Edits.capacity() * sizeof(output::Edit) +
+      getStringsSize(llvm::map_range(this->Edits,
+	  [](const output::Edit &E) -> const std::string& { return E.text; })));
+
+  // One node per location with the string and a hash chain pointer
+  TUMetrics->addMemory("renamedLocations",
+      this->renamedLocations.bucket_count() * sizeof(void*) +
+      this->renamedLocations.size() * (sizeof(std::string) + 2*sizeof(void*)) +
+      getStringsSize(this->renamedLocations));
+  TUMetrics->addMemory("names",
+      this->Names.capacity() * sizeof(std::string) +
+      getStringsSize(this->Names));
+  TUMetrics->addMemory("renames",
+      this->AddSuffixHandler.Renames.capacity() * sizeof(Rename));
+  metrics::addPeakRSS(*TUMetrics);
 }
 
-void AddSuffixMatcher::replaceInMatch(
-    const MatchFinder::MatchResult &result, std::string bindName,
-    SourceRange srcRange, std::string nodeName) {
+void AddSuffixASTConsumer::applyRenames(const std::vector<Rename> &Renames) {
+  llvm::TimeTraceScope TimeScope("AddSuffix rewrite");
+  metrics::Phase Phase(TUMetrics.get(), "rewrite");
+  const SourceManager* mgr = &(this->AddSuffixRewriter.getSourceMgr());
 
-    const SourceManager* mgr = &(this->AddSuffixRewriter.getSourceMgr());
-    const std::string location = std::string(srcRange.printToString(*mgr));
+  for (const auto &R : Renames) {
+    const std::string location = std::string(R.SrcRange.printToString(*mgr));
 
     if (this->renamedLocations.find(location) == 
 	this->renamedLocations.end() ) {
       // If the other matcher has already performed a replacement
       // do not add a suffix agian
-      auto newName = nodeName + this->Suffix;
+      auto newName = R.NodeName.str() + this->Suffix;
+
+      if (this->Stream && this->FlushedOffset > 0 &&
+	  mgr->isWrittenInMainFile(R.SrcRange.getBegin()) &&
+	  mgr->getFileOffset(R.SrcRange.getBegin()) < this->FlushedOffset) {
+	// The output can no longer be corrected, fail the TU rather
+	// than leave the token without its suffix
+	DiagnosticsEngine &Diags = this->Ctx->getDiagnostics();
+	const unsigned LateRenameID = Diags.getCustomDiagID(
+	    DiagnosticsEngine::Error,
+	    "rename of '%0' precedes the output written with -stream");
+	Diags.Report(R.SrcRange.getBegin(), LateRenameID) << R.NodeName;
+	if (TUMetrics) {
+	  TUMetrics->add("lateRenames");
+	}
+      }
 
-      this->AddSuffixRewriter.ReplaceText(srcRange, newName);
+      // Edits in macro expansions and outside of the main file are dropped
+      bool Applied;
+      if (this->Stream) {
+	Applied = !this->AddSuffixRewriter.ReplaceText(R.SrcRange, newName);
+      } else {
+	Applied = this->addEdit(R.SrcRange.getBegin(), std::move(newName));
+      }
       this->renamedLocations.insert(location);
+      if (TUMetrics) {
+	TUMetrics->add(Applied ? "renames" : "droppedRenames");
+      }
 
-      #if DEBUG_AST
-      llvm::errs() << "\033[33m!>\033[0m " << bindName << ": " <<
-	nodeName << "\n";
-      #endif
+      PRINT_TRACE(R.BindName << ": " << R.NodeName);
     } else {
-      #if DEBUG_AST
-      llvm::errs() << "\033[31m!>\033[0m (Duplicate encounter) " << 
-	bindName << ": " << nodeName << "\n";
-      #endif
+      if (TUMetrics) {
+	TUMetrics->add("duplicateRenames");
+      }
+      PRINT_TRACE("(Duplicate encounter) " << R.BindName << ": " <<
+	R.NodeName);
     }
+  }
+}
+
+/// Record the replacement of the token at 'Loc', only the main file is
+/// written and just like with the Rewriter, locations in macro
+/// expansions cannot be rewritten. Returns false if the edit was dropped.
+bool AddSuffixASTConsumer::addEdit(SourceLocation Loc, std::string Text) {
+  const SourceManager &SM = AddSuffixRewriter.getSourceMgr();
+  if (!Loc.isFileID() || SM.getFileID(Loc) != SM.getMainFileID()) {
+    return false;
+  }
+  this->Edits.push_back({SM.getFileOffset(Loc),
+      Lexer::MeasureTokenLength(Loc, SM, AddSuffixRewriter.getLangOpts()),
+      std::move(Text)});
+  return true;
+}
+
+/// Write the rewritten main file from the last flushed offset up to
+/// (and including) the token at 'End'
+/// Stop flushing at the first declaration of the group with templates in
+/// the main file, see stream::hasTemplates()
+void AddSuffixASTConsumer::holdOutput(const DeclGroupRef &DG) {
+  const SourceManager &SM = AddSuffixRewriter.getSourceMgr();
+
+  for (const auto* D : DG) {
+    const auto Begin = SM.getExpansionLoc(D->getBeginLoc());
+    if (Begin.isValid() && SM.isWrittenInMainFile(Begin) &&
+	stream::hasTemplates(D)) {
+      this->HeldOffset = std::min(this->HeldOffset, SM.getFileOffset(Begin));
+      return;
+    }
+  }
 }
 
+void AddSuffixASTConsumer::flushOutput(SourceLocation End) {
+  const SourceManager &SM = AddSuffixRewriter.getSourceMgr();
 
-void AddSuffixMatcher::run(const MatchFinder::MatchResult &result) {
-  this->replaceInDeclMatch(result,    "FunctionDecl");
-  this->replaceInDeclMatch(result,    "VarDecl");
-  this->replaceInDeclRefMatch(result, "DeclRefExpr");
+  End = SM.getExpansionRange(End).getEnd();
+  if (End.isInvalid() || !SM.isWrittenInMainFile(End)) {
+    return;
+  }
+  End = Lexer::getLocForEndOfToken(End, 0, SM, AddSuffixRewriter.getLangOpts());
+
+  const unsigned EndOffset = std::min(SM.getFileOffset(End), this->HeldOffset);
+  if (EndOffset <= this->FlushedOffset) {
+    return;
+  }
+
+  llvm::TimeTraceScope TimeScope("AddSuffix output");
+  metrics::Phase Phase(TUMetrics.get(), "output");
+  const SourceLocation Start = SM.getLocForStartOfFile(SM.getMainFileID())
+    .getLocWithOffset(this->FlushedOffset);
+  llvm::outs() << AddSuffixRewriter.getRewrittenText(
+      CharSourceRange::getCharRange(Start, End));
+  this->FlushedOffset = EndOffset;
 }
 
-void AddSuffixMatcher::onEndOfTranslationUnit() {
-  // Output to stdout
-  AddSuffixRewriter
-      .getEditBuffer(AddSuffixRewriter.getSourceMgr().getMainFileID())
-      .write(llvm::outs());
+void AddSuffixASTConsumer::writeOutput() {
+  llvm::TimeTraceScope TimeScope("AddSuffix output");
+  metrics::Phase Phase(TUMetrics.get(), "output");
+  const SourceManager &SM = AddSuffixRewriter.getSourceMgr();
+
+  if (this->Stream) {
+    // Output the remainder after the last streamed declaration
+    const SourceLocation Start = SM.getLocForStartOfFile(SM.getMainFileID());
+    llvm::outs() << AddSuffixRewriter.getRewrittenText(
+	CharSourceRange::getCharRange(
+	  Start.getLocWithOffset(this->FlushedOffset),
+	  SM.getLocForEndOfFile(SM.getMainFileID())));
+    return;
+  }
+
+  // Output to stdout, anything already written through llvm::outs()
+  // goes first
+  llvm::outs().flush();
+  if (!output::writeEdited(STDOUT_FILENO,
+	SM.getBufferData(SM.getMainFileID()), this->Edits)) {
+    PRINT_ERR("Failed to write the output: " << strerror(errno));
+  }
 }
 
-//-----------------------------------------------------------------------------
-// AddSuffixASTConsumer- implementation
-// https://clang.llvm.org/docs/LibASTMatchersTutorial.html
-// Specifies the node patterns that we want to analyze further in ::run()
-//-----------------------------------------------------------------------------
+void AddSuffixASTConsumer::addMatcherBatch(
+    const DeclarationMatcher &FunctionDeclMatcher,
+    const DeclarationMatcher &VarDeclMatcher,
+    const StatementMatcher &RefExprMatcher) {
+  const auto Batch = std::to_string(++this->BatchCount);
+  const std::string Labels[] = {
+    "AddSuffix/FunctionDecl batch " + Batch,
+    "AddSuffix/VarDecl batch " + Batch,
+    "AddSuffix/DeclRefExpr batch " + Batch
+  };
+  for (const auto &Label : Labels) {
+    Callbacks.push_back(std::make_unique<profile::LabeledCallback>(
+	  Label, &(this->AddSuffixHandler)));
+  }
+  const size_t First = Callbacks.size() - 3;
+
+  Finder.addMatcher(FunctionDeclMatcher, Callbacks[First].get());
+  Finder.addMatcher(VarDeclMatcher,      Callbacks[First + 1].get());
+  Finder.addMatcher(RefExprMatcher,      Callbacks[First + 2].get());
+
+  if (this->Jobs > 1 && !this->Stream) {
+    // A declaration in a chunk can itself be a match
+    ChunkMatchers.push_back(decl(eachOf(FunctionDeclMatcher,
+            forEachDescendant(FunctionDeclMatcher))));
+    ChunkMatchers.push_back(decl(eachOf(VarDeclMatcher,
+            forEachDescendant(VarDeclMatcher))));
+    ChunkMatchers.push_back(decl(forEachDescendant(RefExprMatcher)));
+    ChunkLabels.insert(ChunkLabels.end(), std::begin(Labels), std::end(Labels));
+  }
+}
+
+bool AddSuffixASTConsumer::canMatchConcurrently(ASTContext &Ctx) {
+  if (this->Jobs <= 1 || this->Stream) {
+    return false;
+  }
+  std::string Reason;
+  if (!this->Invocation) {
+    // Needed to parse a copy of the TU for every worker
+    Reason = "no compiler invocation";
+  }
+  if (!Reason.empty() ||
+      !parallel::canMatchConcurrently(Ctx, this->Jobs, Reason)) {
+    PRINT_WARN("Matching serially: " << Reason);
+    return false;
+  }
+  return true;
+}
+
+/// Match every chunk of top-level declarations with a MatchFinder of its own
+/// and apply the renames of each chunk in chunk order. The names of the
+/// renames are interned into a pool for each chunk before the copy of the
+/// TU that the chunk was matched in is freed, their locations are the same
+/// in every copy. The Rewriter and the SourceManager are only used from
+/// this thread.
+void AddSuffixASTConsumer::matchConcurrently(ASTContext &Ctx) {
+  parallel::prepareContext(Ctx);
+  parallel::ChunkRunner Runner(Ctx, this->Jobs,
+      parallel::reparseFrom(*this->Invocation, Ctx.getSourceManager()));
+
+  std::vector<AddSuffixMatcher> Handlers(Runner.getChunkCount());
+  std::vector<StringPool> NamePools(Runner.getChunkCount());
+  std::vector<std::unique_ptr<profile::MatcherProfile>> Profiles(
+      Runner.getChunkCount());
+
+  {
+    llvm::TimeTraceScope TimeScope("AddSuffix matchAST", "concurrent");
+    metrics::Phase Phase(TUMetrics.get(), "matchAST");
+    Runner.run([&](size_t I, parallel::Chunk Chunk, ASTContext &ChunkCtx) {
+      Profiles[I] = std::make_unique<profile::MatcherProfile>();
+      MatchFinder ChunkFinder(
+	  Profiles[I]->getFinderOptions(!this->ProfileDir.empty()));
+      std::vector<std::unique_ptr<profile::LabeledCallback>> ChunkCallbacks;
+
+      for (size_t M = 0; M < this->ChunkMatchers.size(); M++) {
+        ChunkCallbacks.push_back(std::make_unique<profile::LabeledCallback>(
+	      this->ChunkLabels[M], &Handlers[I]));
+        ChunkFinder.addMatcher(this->ChunkMatchers[M],
+	    ChunkCallbacks.back().get());
+      }
+      for (auto* D : Chunk) {
+        ChunkFinder.match(*D, ChunkCtx);
+        Profiles[I]->collect();
+      }
+      for (const auto &C : ChunkCallbacks) {
+        Profiles[I]->addMatches(C->getID(), C->getMatches());
+      }
+      for (auto &R : Handlers[I].Renames) {
+        R.NodeName = NamePools[I].get(NamePools[I].intern(R.NodeName));
+      }
+    });
+  }
+
+  for (size_t I = 0; I < Handlers.size(); I++) {
+    this->applyRenames(Handlers[I].Renames);
+    Profile.merge(*Profiles[I]);
+  }
+}
 
 AddSuffixASTConsumer::AddSuffixASTConsumer(
-    Rewriter &R, std::vector<std::string> Names, std::string Suffix)
-    : AddSuffixHandler(R, Suffix), Names(Names), Suffix(Suffix) {
+    Rewriter &R, std::vector<std::string> Names, std::string Suffix,
+    unsigned Jobs, bool Stream, std::string ProfileDir, bool MemoryReport,
+    std::unique_ptr<trace::Session> TraceSession,
+    std::unique_ptr<metrics::Record> TUMetrics,
+    std::unique_ptr<replay::Bundle> Bundle,
+    std::unique_ptr<skip::BodyFilter> BodyFilter,
+    std::shared_ptr<CompilerInvocation> Invocation)
+    : TraceSession(std::move(TraceSession)), TUMetrics(std::move(TUMetrics)),
+      MemoryReport(MemoryReport), Bundle(std::move(Bundle)),
+      BodyFilter(std::move(BodyFilter)), Invocation(std::move(Invocation)),
+      Finder(Profile.getFinderOptions(!ProfileDir.empty())), Names(Names),
+      AddSuffixRewriter(R), Suffix(Suffix), Jobs(Jobs), Stream(Stream),
+      ProfileDir(ProfileDir) {
+  llvm::TimeTraceScope TimeScope("AddSuffix matchers");
+  metrics::Phase Phase(this->TUMetrics.get(), "matchers");
+
   // The matcher needs to know the number of arguments
   // it recieves at compile time so we haft to rely
   // on a handful of hacky macros to define expressions
@@ -147,11 +462,8 @@ AddSuffixASTConsumer::AddSuffixASTConsumer(
       }
 
     } else { /* 1-9 names left */
-	#if DEBUG_AST
-	llvm::errs() << "\033[33m!>\033[0m Adding suffix onto " << 
-	  Names[namesLeft - 1 ] << 
-	    " ("<<  namesLeft << " to go)\n";
-	#endif
+	PRINT_INFO("Adding suffix onto " << Names[namesLeft - 1] <<
+	  " (" << namesLeft << " to go)");
         // Note that we will not decrement correctly if 
 	// we do it inside of a macro
 	namesLeft--;
@@ -176,13 +488,32 @@ public:
     unsigned suffixDiagID = diagnostics.getCustomDiagID(
 	DiagnosticsEngine::Error, "missing -suffix"
     );
+    unsigned jobsDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing or invalid -jobs"
+    );
+    unsigned profileDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing -profile-matchers"
+    );
+    unsigned traceDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing -time-trace"
+    );
+    unsigned metricsDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing -metrics-file"
+    );
+    unsigned logDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing or invalid -log-level"
+    );
+    unsigned recordDiagID = diagnostics.getCustomDiagID(
+	DiagnosticsEngine::Error, "missing -record"
+    );
+    std::optional<logging::Level> LogLevel;
 
     for (size_t i = 0, size = args.size(); i != size; ++i) {
 
       if (args[i] == "-names-file") {
           if (parseArg(diagnostics, namesDiagID, size, args, i)){
-                auto NamesFile = args[++i];
-		this->readNamesFromFile(NamesFile);
+                // Read once the time trace (if any) has been started
+                this->NamesFile = args[++i];
 	  } else {
                 return false;
 	  }
@@ -194,11 +525,73 @@ public:
                 return false;
 	  }
       }
+      else if (args[i] == "-metrics-file") {
+          if (parseArg(diagnostics, metricsDiagID, size, args, i)){
+                this->MetricsFile = args[++i];
+	  } else {
+                return false;
+	  }
+      }
+      else if (args[i] == "-time-trace") {
+          if (parseArg(diagnostics, traceDiagID, size, args, i)){
+                this->TraceFile = args[++i];
+	  } else {
+                return false;
+	  }
+      }
+      else if (args[i] == "-profile-matchers") {
+          if (parseArg(diagnostics, profileDiagID, size, args, i)){
+                this->ProfileDir = args[++i];
+	  } else {
+                return false;
+	  }
+      }
+      else if (args[i] == "-stream") {
+	  this->Stream = true;
+      }
+      else if (args[i] == "-record") {
+          if (parseArg(diagnostics, recordDiagID, size, args, i)){
+                this->RecordDir = args[++i];
+	  } else {
+                return false;
+	  }
+      }
+      else if (args[i] == "-log-level") {
+          logging::Level Level;
+          if (parseArg(diagnostics, logDiagID, size, args, i)){
+		if (!logging::parseLevel(args[++i], Level)) {
+		  diagnostics.Report(logDiagID);
+		  return false;
+		}
+		LogLevel = Level;
+	  } else {
+                return false;
+	  }
+      }
+      else if (args[i] == "-memory-report") {
+	  this->MemoryReport = true;
+      }
+      else if (args[i] == "-skip-bodies") {
+	  this->SkipBodies = true;
+      }
+      else if (args[i] == "-jobs") {
+          if (parseArg(diagnostics, jobsDiagID, size, args, i)){
+		if (StringRef(args[++i]).getAsInteger(10, this->Jobs) ||
+		    this->Jobs == 0) {
+		  diagnostics.Report(jobsDiagID);
+		  return false;
+		}
+	  } else {
+                return false;
+	  }
+      }
 
       if (!args.empty() && args[0] == "help") {
 	llvm::errs() << "No help available";
       }
     }
+    logging::init(LogLevel);
+    this->PluginArgs = args;
 
     return true;
   }
@@ -208,10 +601,56 @@ public:
   std::unique_ptr<ASTConsumer> 
     CreateASTConsumer(CompilerInstance &CI, StringRef file) override {
 
+    std::unique_ptr<trace::Session> TraceSession;
+    if (!this->TraceFile.empty()) {
+      TraceSession = std::make_unique<trace::Session>(this->TraceFile,
+						      "AddSuffix");
+    }
+    std::unique_ptr<metrics::Record> TUMetrics;
+    const auto MetricsPath = metrics::getPath(this->MetricsFile);
+    if (!MetricsPath.empty()) {
+      TUMetrics = std::make_unique<metrics::Record>(MetricsPath, "AddSuffix");
+    }
+    if (!this->NamesFile.empty() && this->Names.empty()) {
+      llvm::TimeTraceScope TimeScope("AddSuffix names-file", this->NamesFile);
+      metrics::Phase Phase(TUMetrics.get(), "names-file");
+      this->readNamesFromFile(this->NamesFile);
+    }
+
+    std::unique_ptr<replay::Bundle> Bundle;
+    if (!this->RecordDir.empty()) {
+      Bundle = std::make_unique<replay::Bundle>(this->RecordDir, "AddSuffix",
+						this->PluginArgs, CI);
+      if (!this->NamesFile.empty()) {
+	Bundle->addPluginInput(this->NamesFile);
+      }
+    }
+
+    // Copied before skip::enable() changes the options of the running
+    // compiler, the workers parse every body
+    std::shared_ptr<CompilerInvocation> Invocation;
+    if (this->Jobs > 1) {
+      Invocation = std::make_shared<CompilerInvocation>(CI.getInvocation());
+    }
+    std::unique_ptr<skip::BodyFilter> BodyFilter;
+    if (this->SkipBodies) {
+      std::string Reason;
+      if (skip::enable(CI, "AddSuffix", Reason)) {
+	BodyFilter = std::make_unique<skip::BodyFilter>(CI.getPreprocessor(),
+							this->Names);
+      } else {
+	PRINT_WARN("Ignoring -skip-bodies: " << Reason);
+      }
+    }
+
     RewriterForAddSuffix.setSourceMgr(CI.getSourceManager(),
 				      CI.getLangOpts());
     return std::make_unique<AddSuffixASTConsumer>(
-	RewriterForAddSuffix, this->Names, this->Suffix);
+	RewriterForAddSuffix, this->Names, this->Suffix, this->Jobs,
+	this->Stream, this->ProfileDir, this->MemoryReport,
+	std::move(TraceSession),
+	std::move(TUMetrics), std::move(Bundle), std::move(BodyFilter),
+	std::move(Invocation));
   }
 
 private:
@@ -247,6 +686,16 @@ private:
   Rewriter RewriterForAddSuffix;
   std::vector<std::string> Names;
   std::string Suffix;
+  unsigned Jobs = 1;
+  bool Stream = false;
+  bool MemoryReport = false;
+  bool SkipBodies = false;
+  std::string ProfileDir;
+  std::string NamesFile;
+  std::string TraceFile;
+  std::string MetricsFile;
+  std::string RecordDir;
+  std::vector<std::string> PluginArgs;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,41 @@
+#include "AddSuffix.hpp"
+
+#include "clang/AST/Expr.h"
+
+using namespace clang;
+using namespace ast_matchers;
+
+//-----------------------------------------------------------------------------
+// AddSuffixMatcher - implementation
+// Record a rename for matched items
+//-----------------------------------------------------------------------------
+
+void AddSuffixMatcher::replaceInDeclMatch(
+  const MatchFinder::MatchResult &result, const char* bindName) {
+
+    const DeclaratorDecl *node = result.Nodes
+      .getNodeAs<DeclaratorDecl>(bindName);
+
+    if (node) {
+      this->Renames.push_back({node->getLocation(), node->getName(),
+                               bindName});
+    }
+}
+
+void AddSuffixMatcher::replaceInDeclRefMatch(
+    const MatchFinder::MatchResult &result, const char* bindName) {
+
+    const DeclRefExpr *node = result.Nodes
+      .getNodeAs<DeclRefExpr>(bindName);
+    
+    if (node) {
+      this->Renames.push_back({node->getExprLoc(),
+                               node->getDecl()->getName(), bindName});
+    }
+}
+
+void AddSuffixMatcher::run(const MatchFinder::MatchResult &result) {
+  this->replaceInDeclMatch(result,    "FunctionDecl");
+  this->replaceInDeclMatch(result,    "VarDecl");
+  this->replaceInDeclRefMatch(result, "DeclRefExpr");
+}
@@ -0,0 +1,111 @@
+#include "Analysis.hpp"
+#include "AddSuffix.hpp"
+#include "ArgStates.hpp"
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseSet.h"
+
+using namespace clang;
+using namespace ast_matchers;
+
+namespace analysis {
+  void ArgStatesResult::write(std::ostream &f,
+      const ArgStatesOptions &options) const {
+    writeArgStates(f, this->symbolName, this->argumentStates, options,
+        this->pool);
+  }
+
+  ArgStatesResults analyzeArgStates(ASTContext &ctx,
+      const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options) {
+    ArgStatesResults results(symbols.size());
+
+    for (size_t i = 0; i < symbols.size(); i++) {
+      auto &result = results[i];
+      result.symbolName = symbols[i];
+
+      // The same as the serial path of the plugin, the second pass does
+      // not change the states of the first
+      FirstPassASTConsumer firstPass(symbols[i], options, result.pool);
+      firstPass.HandleTranslationUnit(ctx);
+      result.argumentStates =
+        std::move(firstPass.matchHandler.argumentStates);
+      // The results may outlive the AST, as do those of the other overload
+      for (auto &argState : result.argumentStates) {
+        argState.detachIds();
+      }
+    }
+    return results;
+  }
+
+  ArgStatesResults analyzeArgStates(ASTContext &ctx,
+      const std::vector<std::string> &symbols,
+      const ArgStatesOptions &options,
+      const parallel::ContextFactory &factory) {
+    ArgStatesResults results(symbols.size());
+
+    for (size_t i = 0; i < symbols.size(); i++) {
+      auto &result = results[i];
+      result.symbolName = symbols[i];
+
+      FirstPassASTConsumer::matchConcurrently(ctx, symbols[i], options,
+        factory, [&](FirstPassResult &chunk, const StringPool &pool) {
+        auto &states = chunk.argumentStates;
+        if (result.argumentStates.size() < states.size()) {
+          result.argumentStates.resize(states.size());
+        }
+        for (size_t k = 0; k < states.size(); k++) {
+          result.argumentStates[k].merge(states[k], pool, result.pool,
+              options.maxIntRanges);
+        }
+      });
+    }
+    return results;
+  }
+
+  tooling::Replacements computeRenames(ASTContext &ctx,
+      const std::vector<std::string> &names, llvm::StringRef suffix) {
+    tooling::Replacements replacements;
+    if (names.empty()) {
+      return replacements;
+    }
+
+    // The plugin splits the names into batches of hasName() matchers
+    // since it spells them out with macros, hasAnyName() matches the
+    // same declarations in one matcher
+    const std::vector<llvm::StringRef> nameRefs(names.begin(), names.end());
+    const auto hasNames = hasAnyName(nameRefs);
+
+    AddSuffixMatcher handler;
+    MatchFinder finder;
+    finder.addMatcher(functionDecl(hasNames).bind("FunctionDecl"), &handler);
+    finder.addMatcher(varDecl(hasNames).bind("VarDecl"), &handler);
+    finder.addMatcher(declRefExpr(to(declaratorDecl(hasNames)))
+        .bind("DeclRefExpr"), &handler);
+    finder.matchAST(ctx);
+
+    // The same token can be matched more than once, e.g. through
+    // template instantiations
+    const SourceManager &srcMgr = ctx.getSourceManager();
+    llvm::DenseSet<unsigned> renamedLocations;
+
+    // Replacements only hold edits of one file, the plugin only rewrites
+    // the main file
+    for (const auto &R : handler.Renames) {
+      const auto loc = R.SrcRange.getBegin();
+      if (!loc.isFileID() || srcMgr.getFileID(loc) != srcMgr.getMainFileID() ||
+          !renamedLocations.insert(loc.getRawEncoding()).second) {
+        continue;
+      }
+      const tooling::Replacement replacement(srcMgr,
+          CharSourceRange::getTokenRange(R.SrcRange),
+          R.NodeName.str() + suffix.str(), ctx.getLangOpts());
+
+      if (auto err = replacements.add(replacement)) {
+        PRINT_WARN("Skipping rename of " << R.NodeName << ": " <<
+            llvm::toString(std::move(err)));
+      }
+    }
+    return replacements;
+  }
+}
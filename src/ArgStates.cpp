@@ -7,36 +7,310 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendPluginRegistry.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "llvm/ADT/ScopeExit.h"
 
 #include "ArgStates.hpp"
 //-----------------------------------------------------------------------------
 // ArgStatesASTConsumer: Outer wrapper
 //-----------------------------------------------------------------------------
-ArgStatesASTConsumer::ArgStatesASTConsumer(std::string symbolName) {
+ArgStatesASTConsumer::ArgStatesASTConsumer(std::string symbolName,
+ ArgStatesOptions options, std::unique_ptr<replay::Bundle> bundle,
+ std::unique_ptr<skip::BodyFilter> bodyFilter,
+ std::shared_ptr<CompilerInvocation> invocation)
+ : options(options), bundle(std::move(bundle)),
+   bodyFilter(std::move(bodyFilter)), invocation(std::move(invocation)) {
   this->symbolName = symbolName;
+
+  if (!this->options.timeTracePath.empty()) {
+    this->traceSession = std::make_unique<trace::Session>(
+        this->options.timeTracePath, "ArgStates");
+  }
+
+  const auto metricsPath = metrics::getPath(this->options.metricsFile);
+  if (!metricsPath.empty()) {
+    this->tuMetrics = std::make_unique<metrics::Record>(metricsPath,
+        "ArgStates");
+    this->tuMetrics->setLabel("symbol", this->symbolName);
+  }
+
+  if (this->options.stream) {
+    if (this->options.jobs > 1) {
+      PRINT_WARN("Ignoring -jobs: -stream is set");
+    }
+    this->streamPass = std::make_unique<FirstPassASTConsumer>(
+        this->symbolName, this->options, this->pool);
+  }
 }
 
 ArgStatesASTConsumer::~ArgStatesASTConsumer(){
-  this->dumpArgStates();
+  {
+    metrics::Phase phase(this->tuMetrics.get(), "output");
+    this->dumpArgStates();
+  }
+  if (this->tuMetrics) {
+    this->addStateMetrics();
+    this->tuMetrics->addMatches(this->profile.getMatches());
+    if (this->options.memoryReport) {
+      this->tuMetrics->addMemory("pool", this->pool.getMemorySize());
+      metrics::addPeakRSS(*this->tuMetrics);
+    }
+    this->tuMetrics->append();
+  }
+}
+
+void ArgStatesASTConsumer::Initialize(ASTContext &ctx) {
+    this->ctx = &ctx;
+}
+
+bool ArgStatesASTConsumer::HandleTopLevelDecl(DeclGroupRef group) {
+    if (this->streamPass) {
+      metrics::Phase phase(this->tuMetrics.get(), "first pass");
+      this->streamPass->matchScope(this->streamTracker.topLevelDecls(group),
+          *this->ctx);
+    }
+    return true;
+}
+
+void ArgStatesASTConsumer::HandleInlineFunctionDefinition(
+ FunctionDecl *decl) {
+    if (this->streamPass) {
+      metrics::Phase phase(this->tuMetrics.get(), "first pass");
+      this->streamPass->matchScope(this->streamTracker.inlineDefinition(decl),
+          *this->ctx);
+    }
+}
+
+/// Only called with -skip-bodies, a body is skipped unless it
+/// mentions the symbol
+bool ArgStatesASTConsumer::shouldSkipFunctionBody(Decl *decl) {
+    return this->bodyFilter && this->bodyFilter->shouldSkip(decl);
 }
 
 void ArgStatesASTConsumer::HandleTranslationUnit(ASTContext &ctx) {
-    auto firstPass = std::make_unique<FirstPassASTConsumer>(this->symbolName);
-    firstPass->HandleTranslationUnit(ctx);
+    const auto flushTraces = llvm::make_scope_exit([&ctx] {
+      logging::flushTraces(&ctx.getSourceManager());
+    });
+    if (this->bundle) {
+      this->bundle->write(ctx.getSourceManager());
+    }
+    this->checkParams(ctx);
+    if (this->tuMetrics) {
+      this->tuMetrics->setLabel("tu",
+          profile::getTUName(ctx.getSourceManager()));
+      if (this->bodyFilter) {
+        this->tuMetrics->add("skippedBodies",
+            this->bodyFilter->getSkipped());
+        this->tuMetrics->add("parsedBodies", this->bodyFilter->getParsed());
+      }
+      if (this->options.memoryReport) {
+        this->addMemoryMetrics(ctx);
+      }
+    }
+    if (this->streamPass) {
+      this->finishStream();
+      this->writeProfile(ctx);
+      return;
+    }
+    if (this->canMatchConcurrently(ctx)) {
+      this->runFirstPassConcurrently(ctx);
+      this->writeProfile(ctx);
+      return;
+    }
+
+    std::unique_ptr<FirstPassASTConsumer> firstPass;
+    {
+      metrics::Phase phase(this->tuMetrics.get(), "matchers");
+      firstPass = std::make_unique<FirstPassASTConsumer>(this->symbolName,
+        this->options, this->pool);
+    }
+    {
+      llvm::TimeTraceScope timeScope("ArgStates first pass", this->symbolName);
+      metrics::Phase phase(this->tuMetrics.get(), "first pass");
+      firstPass->HandleTranslationUnit(ctx);
+    }
+    firstPass->addProfile(this->profile);
+    this->addMetrics(firstPass->matchHandler);
 
     // The TU name is most easily read from within the match handler
-    this->filename = firstPass->matchHandler.filename;
+    this->filename = firstPass->matchHandler.getFilename();
 
     auto secondPass = std::make_unique<SecondPassASTConsumer>(this->symbolName);
 
     // Copy over the function states
     // Note that the first pass only adds literals and the second adds declrefs
     secondPass->matchHandler.argumentStates =
-      firstPass->matchHandler.argumentStates;
+      std::move(firstPass->matchHandler.argumentStates);
     //secondPass->HandleTranslationUnit(ctx);
 
     // Overwrite the states
-    this->argumentStates = secondPass->matchHandler.argumentStates;
+    this->argumentStates = std::move(secondPass->matchHandler.argumentStates);
+
+    this->writeProfile(ctx);
+}
+
+void ArgStatesASTConsumer::addMetrics(const FirstPassMatcher &handler) {
+    if (this->tuMetrics) {
+      this->tuMetrics->add("callSites", handler.callSites.size());
+      this->tuMetrics->add("duplicateMatches", handler.duplicateMatches);
+      if (this->options.memoryReport) {
+        this->tuMetrics->addMemory("callSites",
+            handler.callSites.getMemorySize());
+      }
+    }
+}
+
+void ArgStatesASTConsumer::addMetrics(const FirstPassResult &result) {
+    if (this->tuMetrics) {
+      this->tuMetrics->add("callSites", result.callSites);
+      this->tuMetrics->add("duplicateMatches", result.duplicateMatches);
+      if (this->options.memoryReport) {
+        this->tuMetrics->addMemory("callSites", result.callSitesMemory);
+      }
+    }
+}
+
+/// Called before the first pass (except with -stream), the parent map is
+/// built here rather than on the first match
+void ArgStatesASTConsumer::addMemoryMetrics(ASTContext &ctx) {
+    metrics::addASTMemory(*this->tuMetrics, ctx);
+    if (!this->streamPass) {
+      metrics::addParentMapMemory(*this->tuMetrics, ctx);
+    }
+}
+
+/// Count the parameters and states that are written to the output
+void ArgStatesASTConsumer::addStateMetrics() {
+    uint64_t det = 0, nondet = 0, states = 0;
+
+    for (uint i = 0; i < this->argumentStates.size(); i++) {
+      const auto &argState = this->argumentStates[i];
+      if (!this->options.params.empty() &&
+          !this->options.params.contains(argState.paramName, i)) {
+        continue;
+      }
+      if (!argState.isNonDet && argState.getIdCount() == 0) {
+        det++;
+        states += argState.chrStates.size() + argState.intStates.size() +
+                  argState.strStates.size();
+      } else {
+        nondet++;
+      }
+    }
+    this->tuMetrics->add("det", det);
+    this->tuMetrics->add("nondet", nondet);
+    this->tuMetrics->add("states", states);
+
+    if (this->options.memoryReport) {
+      uint64_t bytes = this->argumentStates.capacity() * sizeof(ArgState);
+      for (const auto &argState : this->argumentStates) {
+        bytes += argState.getMemorySize() - sizeof(ArgState);
+      }
+      this->tuMetrics->addMemory("argumentStates", bytes);
+    }
+}
+
+void ArgStatesASTConsumer::writeProfile(ASTContext &ctx) {
+    if (this->options.profileDir.empty()) {
+      return;
+    }
+    // <sym_name>_<tu>.profile.json, like the output for the states
+    const auto tu = profile::getTUName(ctx.getSourceManager());
+    this->profile.write(this->options.profileDir,
+        this->symbolName + "_" + tu, tu);
+}
+
+/// Report the entries of -params that select none of the parameters of the
+/// symbol, only declarations at the top level of the TU are considered
+void ArgStatesASTConsumer::checkParams(ASTContext &ctx) {
+    if (this->options.params.empty()) {
+      return;
+    }
+    const auto ident = ctx.Idents.find(this->symbolName);
+    if (ident == ctx.Idents.end()) {
+      return;
+    }
+
+    const auto decls =
+      ctx.getTranslationUnitDecl()->lookup(ident->getValue());
+    for (auto* decl : decls) {
+      const auto* funcDecl = dyn_cast<FunctionDecl>(decl);
+      if (!funcDecl) {
+        continue;
+      }
+      DiagnosticsEngine &diagnostics = ctx.getDiagnostics();
+      const uint unmatchedDiagID = diagnostics.getCustomDiagID(
+        DiagnosticsEngine::Error, "-params: '%0' is not a parameter of '%1'");
+
+      for (const auto &entry : this->options.params.getUnmatched(funcDecl)) {
+        diagnostics.Report(funcDecl->getFirstDecl()->getLocation(),
+            unmatchedDiagID) << entry << this->symbolName;
+      }
+      return;
+    }
+}
+
+bool ArgStatesASTConsumer::canMatchConcurrently(ASTContext &ctx) {
+    if (this->options.jobs <= 1) {
+      return false;
+    }
+
+    std::string reason;
+    if (this->options.spelledOnly) {
+      // The chunk matchers are not wrapped in traverse()
+      reason = "-spelled-only is set";
+    } else if (!this->invocation) {
+      // Needed to parse a copy of the TU for every worker
+      reason = "no compiler invocation";
+    } else if (LOG_ENABLED(logging::Level::Trace)) {
+      // The match traces read node IDs from the shared ASTContext
+      reason = "the log level is 'trace'";
+    } else if (parallel::canMatchConcurrently(ctx, this->options.jobs,
+          reason)) {
+      return true;
+    }
+
+    PRINT_WARN("Matching serially: " << reason);
+    return false;
+}
+
+/// Run the first pass with one FirstPassASTConsumer per chunk of top-level
+/// declarations and merge their results in chunk order. The second pass is
+/// not implemented and therefore skipped.
+void ArgStatesASTConsumer::runFirstPassConcurrently(ASTContext &ctx) {
+    llvm::TimeTraceScope timeScope("ArgStates first pass", this->symbolName);
+    metrics::Phase phase(this->tuMetrics.get(), "first pass");
+
+    FirstPassASTConsumer::matchConcurrently(ctx, this->symbolName,
+      this->options,
+      parallel::reparseFrom(*this->invocation, ctx.getSourceManager()),
+      [&](FirstPassResult &result, const StringPool &chunkPool) {
+      this->profile.merge(result.profile);
+      this->addMetrics(result);
+
+      // The file of the last match in chunk order, as for a serial pass
+      if (!result.filename.empty()) {
+        this->filename = std::move(result.filename);
+      }
+      if (this->argumentStates.size() < result.argumentStates.size()) {
+        this->argumentStates.resize(result.argumentStates.size());
+      }
+      for (size_t k = 0; k < result.argumentStates.size(); k++) {
+        this->argumentStates[k].merge(result.argumentStates[k], chunkPool,
+            this->pool, this->options.maxIntRanges);
+      }
+    });
+}
+
+/// Every declaration has already been matched, the states are only
+/// collected from the first pass. The second pass is not implemented
+/// and therefore skipped.
+void ArgStatesASTConsumer::finishStream() {
+    auto &handler = this->streamPass->matchHandler;
+    this->streamPass->addProfile(this->profile);
+    this->addMetrics(handler);
+    this->filename = handler.getFilename();
+    this->argumentStates = std::move(handler.argumentStates);
+    this->streamPass.reset();
 }
 
 //-----------------------------------------------------------------------------
@@ -48,12 +322,36 @@ public:
   bool ParseArgs(const CompilerInstance &CI,
                  const std::vector<std::string> &args) override {
 
-    srand(time(NULL));
     DiagnosticsEngine &diagnostics = CI.getDiagnostics();
 
     uint namesDiagID = diagnostics.getCustomDiagID(
       DiagnosticsEngine::Error, "missing -symbol-name"
     );
+    uint rangesDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing or invalid -max-int-ranges"
+    );
+    uint jobsDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing or invalid -jobs"
+    );
+    uint paramsDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing or invalid -params"
+    );
+    uint profileDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing -profile-matchers"
+    );
+    uint traceDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing -time-trace"
+    );
+    uint metricsDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing -metrics-file"
+    );
+    uint logDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing or invalid -log-level"
+    );
+    uint recordDiagID = diagnostics.getCustomDiagID(
+      DiagnosticsEngine::Error, "missing -record"
+    );
+    std::optional<logging::Level> logLevel;
 
     for (size_t i = 0, size = args.size(); i != size; ++i) {
       if (args[i] == "-symbol-name") {
@@ -63,10 +361,104 @@ public:
              return false;
          }
       }
+      else if (args[i] == "-max-int-ranges") {
+         if (parseArg(diagnostics, rangesDiagID, size, args, i)){
+             if (StringRef(args[++i]).getAsInteger(10,
+                  this->options.maxIntRanges)) {
+               diagnostics.Report(rangesDiagID);
+               return false;
+             }
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-int-ranges") {
+         this->options.intRanges = true;
+      }
+      else if (args[i] == "-spelled-only") {
+         this->options.spelledOnly = true;
+      }
+      else if (args[i] == "-stream") {
+         this->options.stream = true;
+      }
+      else if (args[i] == "-memory-report") {
+         this->options.memoryReport = true;
+      }
+      else if (args[i] == "-skip-bodies") {
+         this->options.skipBodies = true;
+      }
+      else if (args[i] == "-profile-matchers") {
+         if (parseArg(diagnostics, profileDiagID, size, args, i)){
+             this->options.profileDir = args[++i];
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-metrics-file") {
+         if (parseArg(diagnostics, metricsDiagID, size, args, i)){
+             this->options.metricsFile = args[++i];
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-time-trace") {
+         if (parseArg(diagnostics, traceDiagID, size, args, i)){
+             this->options.timeTracePath = args[++i];
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-record") {
+         if (parseArg(diagnostics, recordDiagID, size, args, i)){
+             this->recordDir = args[++i];
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-log-level") {
+         logging::Level level;
+         if (parseArg(diagnostics, logDiagID, size, args, i)){
+             if (!logging::parseLevel(args[++i], level)) {
+               diagnostics.Report(logDiagID);
+               return false;
+             }
+             logLevel = level;
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-params") {
+         if (parseArg(diagnostics, paramsDiagID, size, args, i)){
+             if (!this->options.params.parse(args[++i])) {
+               diagnostics.Report(paramsDiagID);
+               return false;
+             }
+         } else {
+             return false;
+         }
+      }
+      else if (args[i] == "-jobs") {
+         if (parseArg(diagnostics, jobsDiagID, size, args, i)){
+             if (StringRef(args[++i]).getAsInteger(10, this->options.jobs) ||
+                 this->options.jobs == 0) {
+               diagnostics.Report(jobsDiagID);
+               return false;
+             }
+         } else {
+             return false;
+         }
+      }
       if (!args.empty() && args[0] == "help") {
         llvm::errs() << "No help available";
       }
     }
+    // Joined intervals cannot be enumerated, a limit on the number of
+    // intervals therefore implies range output
+    if (this->options.maxIntRanges > 0) {
+      this->options.intRanges = true;
+    }
+    logging::init(logLevel);
+    this->pluginArgs = args;
 
     return true;
   }
@@ -76,7 +468,30 @@ public:
   //  https://clang.llvm.org/docs/RAVFrontendAction.html
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
   StringRef file) override {
-    return std::make_unique<ArgStatesASTConsumer>(this->symbolName);
+    std::unique_ptr<replay::Bundle> bundle;
+    if (!this->recordDir.empty()) {
+      bundle = std::make_unique<replay::Bundle>(this->recordDir, "ArgStates",
+          this->pluginArgs, CI);
+    }
+    // Copied before skip::enable() changes the options of the running
+    // compiler, the workers parse every body
+    std::shared_ptr<CompilerInvocation> invocation;
+    if (this->options.jobs > 1) {
+      invocation = std::make_shared<CompilerInvocation>(CI.getInvocation());
+    }
+    std::unique_ptr<skip::BodyFilter> bodyFilter;
+    if (this->options.skipBodies) {
+      std::string reason;
+      if (skip::enable(CI, "ArgStates", reason)) {
+        bodyFilter = std::make_unique<skip::BodyFilter>(CI.getPreprocessor(),
+            std::vector<std::string>{this->symbolName});
+      } else {
+        PRINT_WARN("Ignoring -skip-bodies: " << reason);
+      }
+    }
+    return std::make_unique<ArgStatesASTConsumer>(this->symbolName,
+        this->options, std::move(bundle), std::move(bodyFilter),
+        std::move(invocation));
   }
 
 private:
@@ -95,6 +510,11 @@ private:
   }
 
   std::string symbolName;
+  ArgStatesOptions options;
+
+  // -record <dir> (see Replay.hpp)
+  std::string recordDir;
+  std::vector<std::string> pluginArgs;
 };
 
 static FrontendPluginRegistry::Add<ArgStatesAddPluginAction>
@@ -0,0 +1,130 @@
+#include "Domains.hpp"
+
+#include <algorithm>
+#include <limits>
+
+//-----------------------------------------------------------------------------
+// CharDomain - implementation
+//-----------------------------------------------------------------------------
+bool CharDomain::insert(unsigned value) {
+  if (value < bits.size()) {
+    const bool isNew = !bits.test(value);
+    bits.set(value);
+    return isNew;
+  }
+  return wide.insert(value);
+}
+
+size_t CharDomain::count(unsigned value) const {
+  if (value < bits.size()) {
+    return bits.test(value) ? 1 : 0;
+  }
+  return wide.count(value);
+}
+
+void CharDomain::merge(const CharDomain &other) {
+  bits |= other.bits;
+  wide.merge(other.wide);
+}
+
+//-----------------------------------------------------------------------------
+// IntDomain - implementation
+//-----------------------------------------------------------------------------
+bool IntDomain::insert(uint64_t value, unsigned maxIntervals) {
+  // The first interval that ends at or after the value
+  auto it = std::lower_bound(intervals.begin(), intervals.end(), value,
+      [](const Interval &interval, uint64_t v) { return interval.last < v; });
+
+  if (it != intervals.end() && it->first <= value) {
+    return false;
+  }
+
+  const size_t index = it - intervals.begin();
+  intervals.insert(it, Interval{value, value});
+  this->coalesce(index);
+  this->limit(maxIntervals);
+  return true;
+}
+
+size_t IntDomain::count(uint64_t value) const {
+  auto it = std::lower_bound(intervals.begin(), intervals.end(), value,
+      [](const Interval &interval, uint64_t v) { return interval.last < v; });
+  return it != intervals.end() && it->first <= value ? 1 : 0;
+}
+
+void IntDomain::merge(const IntDomain &other, unsigned maxIntervals) {
+  if (other.empty()) {
+    return;
+  }
+
+  llvm::SmallVector<Interval, 4> merged;
+  merged.reserve(intervals.size() + other.intervals.size());
+  std::merge(intervals.begin(), intervals.end(),
+             other.intervals.begin(), other.intervals.end(),
+             std::back_inserter(merged),
+             [](const Interval &a, const Interval &b) {
+               return a.first < b.first;
+             });
+
+  // Join overlapping and adjacent intervals in one sweep
+  intervals.clear();
+  for (const auto &interval : merged) {
+    if (!intervals.empty() && (intervals.back().last >= interval.first ||
+        intervals.back().last + 1 == interval.first)) {
+      intervals.back().last = std::max(intervals.back().last, interval.last);
+    } else {
+      intervals.push_back(interval);
+    }
+  }
+
+  exact = exact && other.exact;
+  this->limit(maxIntervals);
+}
+
+uint64_t IntDomain::size() const {
+  uint64_t total = 0;
+  for (const auto &interval : intervals) {
+    const uint64_t width = interval.last - interval.first;
+    if (width >= std::numeric_limits<uint64_t>::max() - total) {
+      return std::numeric_limits<uint64_t>::max();
+    }
+    total += width + 1;
+  }
+  return total;
+}
+
+/// Join the interval at the given index with its neighbours if they are
+/// adjacent to it
+void IntDomain::coalesce(size_t index) {
+  if (index + 1 < intervals.size() &&
+      intervals[index].last + 1 == intervals[index+1].first) {
+    intervals[index].last = intervals[index+1].last;
+    intervals.erase(intervals.begin() + index + 1);
+  }
+  if (index > 0 && intervals[index-1].last + 1 == intervals[index].first) {
+    intervals[index-1].last = intervals[index].last;
+    intervals.erase(intervals.begin() + index);
+  }
+}
+
+void IntDomain::limit(unsigned maxIntervals) {
+  if (maxIntervals == 0) {
+    return;
+  }
+
+  while (intervals.size() > maxIntervals) {
+    // Join the pair of neighbours with the smallest gap between them
+    size_t closest = 0;
+    uint64_t smallestGap = std::numeric_limits<uint64_t>::max();
+    for (size_t i = 0; i + 1 < intervals.size(); i++) {
+      const uint64_t gap = intervals[i+1].first - intervals[i].last;
+      if (gap < smallestGap) {
+        smallestGap = gap;
+        closest = i;
+      }
+    }
+    intervals[closest].last = intervals[closest+1].last;
+    intervals.erase(intervals.begin() + closest + 1);
+    exact = false;
+  }
+}
@@ -0,0 +1,221 @@
+#include "FileCache.hpp"
+
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/Path.h"
+
+#include <mutex>
+
+using namespace llvm;
+
+namespace filecache {
+  //---------------------------------------------------------------------------
+  // Cache
+  //---------------------------------------------------------------------------
+  Stats Cache::getStats() const {
+    Stats out;
+    out.statHits = this->statHits;
+    out.statMisses = this->statMisses;
+    out.readHits = this->readHits;
+    out.readMisses = this->readMisses;
+    std::shared_lock<std::shared_mutex> lock(this->fileMutex);
+    out.bytes = this->bytes;
+    return out;
+  }
+
+  void Cache::newBatch() {
+    {
+      std::unique_lock<std::shared_mutex> lock(this->statMutex);
+      this->stats.clear();
+    }
+    std::unique_lock<std::shared_mutex> lock(this->fileMutex);
+    const uint64_t current = this->generation;
+    for (auto it = this->files.begin(); it != this->files.end();) {
+      auto entry = it++;
+      if (entry->second.lastUsed != current) {
+        this->bytes -= entry->second.buffer->getBufferSize();
+        this->files.erase(entry);
+      }
+    }
+    this->generation++;
+  }
+
+  std::optional<ErrorOr<vfs::Status>> Cache::lookupStatus(StringRef path) {
+    std::shared_lock<std::shared_mutex> lock(this->statMutex);
+    const auto it = this->stats.find(path);
+    if (it == this->stats.end()) {
+      this->statMisses++;
+      return std::nullopt;
+    }
+    this->statHits++;
+    return it->second;
+  }
+
+  void Cache::storeStatus(StringRef path, const ErrorOr<vfs::Status> &status) {
+    // Only the absence of a file is remembered, other errors may not
+    // occur again
+    if (!status && status.getError() != errc::no_such_file_or_directory) {
+      return;
+    }
+    std::unique_lock<std::shared_mutex> lock(this->statMutex);
+    const auto entry = this->stats.try_emplace(path, status);
+    if (!entry.second) {
+      entry.first->second = status;
+    }
+  }
+
+  std::shared_ptr<MemoryBuffer> Cache::lookupFile(StringRef path,
+      const vfs::Status &status) {
+    std::shared_lock<std::shared_mutex> lock(this->fileMutex);
+    const auto it = this->files.find(path);
+    if (it == this->files.end() ||
+        it->second.status.getLastModificationTime() !=
+          status.getLastModificationTime() ||
+        it->second.status.getSize() != status.getSize()) {
+      this->readMisses++;
+      return nullptr;
+    }
+    this->readHits++;
+    it->second.lastUsed = this->generation.load();
+    return it->second.buffer;
+  }
+
+  void Cache::storeFile(StringRef path, const vfs::Status &status,
+      std::shared_ptr<MemoryBuffer> buffer) {
+    std::unique_lock<std::shared_mutex> lock(this->fileMutex);
+    // The entry of the previous version is stale either way, it must not
+    // be kept (and counted) if the new version does not fit
+    const auto it = this->files.find(path);
+    if (it != this->files.end()) {
+      this->bytes -= it->second.buffer->getBufferSize();
+      this->files.erase(it);
+    }
+    if (this->bytes + buffer->getBufferSize() > this->maxBytes) {
+      return;
+    }
+    this->bytes += buffer->getBufferSize();
+    auto &entry = this->files[path];
+    entry.status = status;
+    entry.buffer = std::move(buffer);
+    entry.lastUsed = this->generation.load();
+  }
+
+  //---------------------------------------------------------------------------
+  // CachingFileSystem
+  //---------------------------------------------------------------------------
+  /// A read-only view of a cached buffer that keeps it alive
+  class SharedBuffer : public MemoryBuffer {
+  public:
+    SharedBuffer(std::shared_ptr<MemoryBuffer> owner, StringRef name,
+        bool requiresNullTerminator)
+      : owner(std::move(owner)), name(name.str()) {
+      this->init(this->owner->getBufferStart(), this->owner->getBufferEnd(),
+                 requiresNullTerminator);
+    }
+
+    StringRef getBufferIdentifier() const override { return name; }
+    BufferKind getBufferKind() const override {
+      return owner->getBufferKind();
+    }
+
+  private:
+    std::shared_ptr<MemoryBuffer> owner;
+    std::string name;
+  };
+
+  class CachedFile : public vfs::File {
+  public:
+    CachedFile(vfs::Status status, std::shared_ptr<MemoryBuffer> buffer)
+      : fileStatus(std::move(status)), buffer(std::move(buffer)) {}
+
+    ErrorOr<vfs::Status> status() override { return fileStatus; }
+
+    ErrorOr<std::unique_ptr<MemoryBuffer>> getBuffer(const Twine &name,
+        int64_t, bool requiresNullTerminator, bool) override {
+      return std::unique_ptr<MemoryBuffer>(std::make_unique<SharedBuffer>(
+            buffer, name.str(), requiresNullTerminator));
+    }
+
+    std::error_code close() override { return {}; }
+
+  private:
+    vfs::Status fileStatus;
+    std::shared_ptr<MemoryBuffer> buffer;
+  };
+
+  CachingFileSystem::CachingFileSystem(Cache &cache,
+      IntrusiveRefCntPtr<vfs::FileSystem> base)
+    : ProxyFileSystem(std::move(base)), cache(cache) {}
+
+  bool CachingFileSystem::getKey(const Twine &path,
+      SmallVectorImpl<char> &key) {
+    path.toVector(key);
+    if (this->makeAbsolute(key)) {
+      return false;
+    }
+    // '..' is kept, it can follow a symlink
+    sys::path::remove_dots(key, /*remove_dot_dot=*/false);
+    return true;
+  }
+
+  ErrorOr<vfs::Status> CachingFileSystem::status(const Twine &path) {
+    SmallString<256> key;
+    if (!this->getKey(path, key)) {
+      return ProxyFileSystem::status(path);
+    }
+    if (auto cached = this->cache.lookupStatus(key)) {
+      if (!*cached) {
+        return cached->getError();
+      }
+      return vfs::Status::copyWithNewName(**cached, path);
+    }
+    auto status = ProxyFileSystem::status(path);
+    this->cache.storeStatus(key, status);
+    return status;
+  }
+
+  ErrorOr<std::unique_ptr<vfs::File>>
+  CachingFileSystem::openFileForRead(const Twine &path) {
+    SmallString<256> key;
+    if (!this->getKey(path, key)) {
+      return ProxyFileSystem::openFileForRead(path);
+    }
+    // Not from the cached stats, the file may have been rewritten since
+    // it was stat'ed in this batch
+    const auto status = ProxyFileSystem::status(path);
+    this->cache.storeStatus(key, status);
+    if (!status) {
+      return status.getError();
+    }
+    if (status->isDirectory()) {
+      return ProxyFileSystem::openFileForRead(path);
+    }
+
+    auto buffer = this->cache.lookupFile(key, *status);
+    vfs::Status fileStatus = *status;
+    if (!buffer) {
+      auto file = ProxyFileSystem::openFileForRead(path);
+      if (!file) {
+        return file.getError();
+      }
+      if (auto opened = (*file)->status()) {
+        fileStatus = vfs::Status::copyWithNewName(*opened, path);
+      }
+      // Always null-terminated, the buffers are shared between callers
+      auto read = (*file)->getBuffer(key, fileStatus.getSize(),
+          /*RequiresNullTerminator=*/true, /*IsVolatile=*/false);
+      if (!read) {
+        return read.getError();
+      }
+      buffer = std::shared_ptr<MemoryBuffer>(std::move(*read));
+      this->cache.storeFile(key, fileStatus, buffer);
+    }
+    return std::unique_ptr<vfs::File>(
+        std::make_unique<CachedFile>(fileStatus, std::move(buffer)));
+  }
+
+  IntrusiveRefCntPtr<vfs::FileSystem> createFileSystem(Cache &cache) {
+    IntrusiveRefCntPtr<vfs::FileSystem> base(
+        vfs::createPhysicalFileSystem().release());
+    return makeIntrusiveRefCnt<CachingFileSystem>(cache, std::move(base));
+  }
+}
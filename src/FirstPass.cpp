@@ -7,45 +7,84 @@ const char* LITERAL[] = {
   "CHR", "INT", "STR", "UNARY", "NONE"
 };
 
-const std::unordered_map<std::string,StateType> NodeTypes {
-  {"CharacterLiteral", CHR},
-  {"IntegerLiteral", INT},
-  {"StringLiteral", STR},
-  {"UnaryExprOrTypeTraitExpr", UNARY},
-  {"DeclRefExpr", NONE}
-};
+// The StateType for each class of leaf node that we can handle,
+// other node classes have no corresponding StateType
+static constexpr std::optional<StateType> getStateType(
+ Stmt::StmtClass stmtClass) {
+  switch (stmtClass) {
+    case Stmt::CharacterLiteralClass:         return CHR;
+    case Stmt::IntegerLiteralClass:           return INT;
+    case Stmt::StringLiteralClass:            return STR;
+    case Stmt::UnaryExprOrTypeTraitExprClass: return UNARY;
+    case Stmt::DeclRefExprClass:              return NONE;
+    default:                                  return std::nullopt;
+  }
+}
+
+// Exactly a CallExpr, subclasses (e.g. CXXMemberCallExpr) have other kinds
+static const auto CallExprKind = ASTNodeKind::getFromNodeKind<CallExpr>();
+
+// Runs 'inner' on the arguments for the parameters selected with -params,
+// like in getParam() the names are taken from the first declaration of the
+// function. The selection is checked before 'inner' so that the subtrees
+// of the other arguments are never searched. Like forEachArgumentWithParam(),
+// every matching argument gives a separate match.
+AST_MATCHER_P2(CallExpr, forEachSelectedArgument, const ParamSelection*,
+ selection, internal::Matcher<Expr>, inner) {
+  const auto funcDecl = Node.getDirectCallee();
+  if (!funcDecl) {
+    return false;
+  }
+  const auto firstDecl = funcDecl->getFirstDecl();
+  const auto numArgs = std::min(Node.getNumArgs(), firstDecl->getNumParams());
+
+  BoundNodesTreeBuilder result;
+  bool matched = false;
+
+  for (unsigned i = 0; i < numArgs; i++) {
+    if (!selection->contains(firstDecl->getParamDecl(i)->getName(), i)) {
+      continue;
+    }
+    BoundNodesTreeBuilder argMatches(*Builder);
+    if (inner.matches(*Node.getArg(i), Finder, &argMatches)) {
+      result.addMatch(argMatches);
+      matched = true;
+    }
+  }
+  *Builder = std::move(result);
+  return matched;
+}
 
-void FirstPassMatcher::getCallPath(DynTypedNode &parent,
- std::string bindName, std::vector<DynTypedNode> &callPath){
+void FirstPassMatcher::getCallPath(const DynTypedNode &parent){
     // Go up until we reach a call expression
-    callPath.push_back(parent);
+    this->callPath.push_back(parent);
 
-    // The ASTNodeKind returned from this method reflects the strings seen in
-    //  clang -ast-dump
-    if (parent.getNodeKind().asStringRef() == "CallExpr"){
-      // There should be an enum for us to match against but I cannot find it...
+    if (parent.getNodeKind().isSame(CallExprKind)){
       return;
     } else {
       auto parents = this->ctx->getParents(parent);
       if (parents.size()>0) {
         // We assume .getParents() only returns one entry
-        auto newParent = parents[0];
-        getCallPath(newParent, bindName, callPath);
+        getCallPath(parents[0]);
       }
     }
 }
 
 /// Returns the parameter index and parameter name given a matched expression
 /// under the matched call (an empty parameter name is
-/// given for unnamed parameters)
-std::tuple<std::string,int> FirstPassMatcher::getParam(
+/// given for unnamed parameters). The path up to the call is left
+/// in this->callPath.
+///
+/// The returned name references the identifier table of the
+/// ASTContext and remains valid for the lifetime of the TU
+std::tuple<StringRef,int> FirstPassMatcher::getParam(
  const CallExpr* matchedCall,
- std::vector<DynTypedNode>& callPath,
- const char* bindName){
-  std::string paramName = "";
+ const Expr* matchedExpr){
+  StringRef paramName = "";
   int  argumentIndex = -1;
-  auto matchedNode = this->nodeMap.at(bindName);
-  auto parents = this->ctx->getParents(matchedNode);
+  auto parents = this->ctx->getParents(*matchedExpr);
+
+  this->callPath.clear();
 
   if (parents.size()>0) {
     // We assume .getParents() only returns one entry
@@ -54,35 +93,35 @@ std::tuple<std::string,int> FirstPassMatcher::getParam(
     // (we need to drop implicit casts etc.)
     // Since we save all of the nodes in the path we traverse
     // upwards, we can check which of the arguments our path corresponds to
-    getCallPath(parent, bindName, callPath);
+    getCallPath(parent);
 
     // We use .push_back() so the last item will be the actual call,
     // we are interested in the direct child from the call that is on the
     // path towards our match, which will be at the penultimate position,
     // if the callPath only contains one item, then our matched node is
     // a direct child of the callexpr
-    auto ourPath = callPath.size() > 1 ?
-      callPath[callPath.size()-2] :
-      matchedNode;
-
-    auto ourExpr = ourPath.get<Expr>();
+    auto ourExpr = callPath.size() > 1 ?
+      callPath[callPath.size()-2].get<Expr>() :
+      matchedExpr;
 
     argumentIndex = 0;
     for (auto call_arg : matchedCall->arguments()){
       // Break once we find an argument in the matched call expression
       // that matches the node we found traversing the AST upwards from
-      // our match
-      if (call_arg->getID(*ctx) == ourExpr->getID(*ctx) ) {
+      // our match. Nodes are compared by identity, Stmt::getID() is
+      // not cheap enough for this loop since it needs to search through the
+      // slabs of the ASTContext allocator
+      if (call_arg == ourExpr) {
         break;
       }
       argumentIndex++;
     }
 
-    if ( ourExpr->getID(*ctx) == matchedCall->getCallee()->getID(*ctx) ){
+    if ( ourExpr == matchedCall->getCallee() ){
       // Check if our expression actually corresponds to the
       // functionDecl node at index '-1'
       // The paramName will be the function name in this case
-      paramName = std::string(matchedCall->getDirectCallee()->getName());
+      paramName = matchedCall->getDirectCallee()->getName();
       argumentIndex = -1;
     }
     else if (argumentIndex < int(matchedCall->getNumArgs()) ){
@@ -108,7 +147,7 @@ std::tuple<std::string,int> FirstPassMatcher::getParam(
 
         // Some declarations omit naming their parameters, e.g.
         // void foo(int, char*), the name will be empty in these scenarios
-        paramName             = std::string(paramDecl->getName());
+        paramName             = paramDecl->getName();
       }
     }
   }
@@ -116,12 +155,78 @@ std::tuple<std::string,int> FirstPassMatcher::getParam(
   return std::tuple(paramName,argumentIndex);
 }
 
-void FirstPassMatcher::handleLiteralMatch(variants value,
+/// Add where a location is spelled to 'id'. For locations inside of macro
+/// expansions this covers the spelling location at every level of the
+/// expansion except the location where the outermost macro was invoked,
+/// every expansion of the same macro therefore gives the same locations.
+/// Nodes in template instantiations share the locations of their pattern.
+void FirstPassMatcher::addSpelling(llvm::FoldingSetNodeID &id,
+ SourceLocation loc) {
+  llvm::SmallVector<SourceLocation, 4> spelling;
+  if (loc.isFileID()) {
+    spelling.push_back(loc);
+  }
+  while (loc.isMacroID()) {
+    spelling.push_back(this->srcMgr->getSpellingLoc(loc));
+    loc = this->srcMgr->getImmediateMacroCallerLoc(loc);
+  }
+
+  // The number of levels goes first so that the key stays unambiguous
+  id.AddInteger(spelling.size());
+  for (const auto spellingLoc : spelling) {
+    id.AddInteger(spellingLoc.getRawEncoding());
+  }
+}
+
+/// A call that is expanded from a macro is matched once per expansion and a
+/// call inside a template once per instantiation. Copies of a call that
+/// have the same structure are classified identically, we only need to
+/// handle the first one.
+///
+/// Returns true if the call is spelled at the same location as a call that
+/// has already been handled and is structurally identical to it, i.e. has
+/// the same Stmt::Profile(). The profile includes the literal values, the
+/// (canonical) types, e.g. the argument of sizeof(T), and the referenced
+/// declarations of the entire call. The decision is made once for every
+/// call, all matches under a duplicate call are skipped so that the ids[]
+/// of the parameters stay consistent.
+///
+/// Calls in a template pattern are skipped as well, their arguments, e.g.
+/// sizeof(T), are classified in every instantiation instead. With
+/// -spelled-only the instantiations are not visited and the pattern is kept.
+bool FirstPassMatcher::isDuplicate(const CallExpr* call, const Stmt* node) {
+  if (!this->options.spelledOnly && call->isInstantiationDependent()) {
+    return true;
+  }
+  const auto site = this->callSites.try_emplace(call, false);
+  if (site.second) {
+    llvm::FoldingSetNodeID id;
+    this->addSpelling(id, call->getBeginLoc());
+    call->Profile(id, *this->ctx, /*Canonical=*/true);
+    // Profiles are compared in full, calls with the same hash are
+    // not necessarily identical
+    auto &bucket = this->seenCalls[id.ComputeHash()];
+    const bool isKnown = llvm::any_of(bucket,
+        [&](const llvm::FoldingSetNodeIDRef &ref) { return id == ref; });
+    if (!isKnown) {
+      bucket.push_back(id.Intern(this->callKeys));
+    }
+    site.first->second = isKnown;
+  }
+
+  const bool isDuplicateCall = site.first->second;
+  if (isDuplicateCall) {
+    this->duplicateMatches++;
+    util::dumpMatch("DUP", node->getStmtClassName(), 1, node->getBeginLoc());
+  }
+  return isDuplicateCall;
+}
+
+void FirstPassMatcher::handleLiteralMatch(const variants &value,
 StateType matchedType, const CallExpr* call, const Expr* matchedExpr){
   // Determine which parameter this argument corresponds to
-  auto callPath = std::vector<DynTypedNode>();
-  const auto param = this->getParam(call, callPath, LITERAL[matchedType]);
-  const std::string paramName  = std::get<0>(param);
+  const auto param = this->getParam(call, matchedExpr);
+  const StringRef paramName    = std::get<0>(param);
   const int paramIndex         = std::get<1>(param);
 
   // An argState entry should already exist from the
@@ -131,15 +236,15 @@ StateType matchedType, const CallExpr* call, const Expr* matchedExpr){
   // The callPath always contains at least one element: <match> [ callexpr ]
   assert(callPath.size() >= 1);
 
-  const auto argState         = this->argumentStates[paramIndex];
-  const auto firtstParentKind = callPath[0].getNodeKind().asStringRef();
+  auto &argState              = this->argumentStates[paramIndex];
+  const auto firstParentKind  = callPath[0].getNodeKind();
 
   bool matchIsDet = false;
 
   if (argState.isNonDet){
     // Already identified as nondet()
   }
-  else if (callPath.size() == 1 && firtstParentKind == "CallExpr") {
+  else if (callPath.size() == 1 && firstParentKind.isSame(CallExprKind)) {
     // If the callPath only contains 1 element we have an exact call, e.g.
     //  foo(int x) -> foo(1)
     matchIsDet = true;
@@ -165,31 +270,31 @@ StateType matchedType, const CallExpr* call, const Expr* matchedExpr){
     const auto topArg = callPath[callPath.size()-2].get<Expr>();
     const auto simplifiedTopArg = topArg->IgnoreParenNoopCasts(*ctx) \
                                   ->IgnoreImplicit()->IgnoreCasts();
-    const auto type = simplifiedTopArg->getStmtClassName();
-    if (NodeTypes.count(type) > 0 &&  NodeTypes.at(type) == matchedType){
+    if (getStateType(simplifiedTopArg->getStmtClass()) == matchedType){
         matchIsDet = true;
     }
   }
 
   if (matchIsDet){
-    this->argumentStates[paramIndex].states.insert(value);
+    this->argumentStates[paramIndex].addState(value, this->pool,
+        this->options.maxIntRanges);
 
     // We remove the ids for every match that corresponds to a det() case
     // At the final write-to-disk stage, the params with an empty ids[] set
     // are those that can be considered det()
     // Exactly one element should be erased with this operation
-    assert(
-      this->argumentStates[paramIndex].ids.erase(matchedExpr->getID(*ctx))
-      == 1
-    );
+    const auto erased =
+      this->argumentStates[paramIndex].ids.erase(matchedExpr);
+    assert(erased);
+    (void)erased;
 
-    PRINT_INFO(LITERAL[matchedType] << "> " << paramName << " (det): "
+    PRINT_TRACE(LITERAL[matchedType] << "> " << paramName << " (det): "
         << matchedExpr->getID(*ctx) << " ("
         << this->argumentStates[paramIndex].ids.size() << ")" );
   } else {
     // Unmatched base case: nondet()
     this->argumentStates[paramIndex].isNonDet = true;
-    PRINT_INFO(LITERAL[matchedType] << "> " << paramName << " (nondet): "
+    PRINT_TRACE(LITERAL[matchedType] << "> " << paramName << " (nondet): "
         << matchedExpr->getID(*ctx) << " ("
         << this->argumentStates[paramIndex].ids.size() << ")" );
   }
@@ -201,11 +306,105 @@ StateType matchedType, const CallExpr* call, const Expr* matchedExpr){
 //-----------------------------------------------------------------------------
 
 void FirstPassASTConsumer::HandleTranslationUnit(ASTContext &ctx) {
+  llvm::TimeTraceScope timeScope("ArgStates matchAST");
   this->finder.matchAST(ctx);
+  this->profile.collect();
+}
+
+void FirstPassASTConsumer::matchChunk(parallel::Chunk chunk,
+ ASTContext &ctx) {
+  for (auto* decl : chunk) {
+    this->finder.match(*decl, ctx);
+    this->profile.collect();
+  }
+}
+
+void FirstPassASTConsumer::detach(FirstPassResult &out) {
+  auto &handler = this->matchHandler;
+  out.argumentStates = std::move(handler.argumentStates);
+  for (auto &argState : out.argumentStates) {
+    argState.detachIds();
+  }
+  out.filename = handler.getFilename();
+  out.callSites = handler.callSites.size();
+  out.callSitesMemory = handler.callSites.getMemorySize();
+  out.duplicateMatches = handler.duplicateMatches;
+  this->addProfile(out.profile);
+}
+
+void FirstPassASTConsumer::matchConcurrently(ASTContext &ctx,
+ const std::string &symbolName, const ArgStatesOptions &options,
+ parallel::ContextFactory factory,
+ const std::function<void(FirstPassResult&, const StringPool&)> &merge) {
+  parallel::prepareContext(ctx);
+  parallel::ChunkRunner runner(ctx, options.jobs, std::move(factory));
+
+  const auto chunkCount = runner.getChunkCount();
+  std::vector<StringPool> pools(chunkCount);
+  std::vector<FirstPassResult> results(chunkCount);
+
+  // The copy of the TU that a chunk was matched in is freed once its
+  // worker is done, the pass is detached from it right away
+  runner.run([&](size_t i, parallel::Chunk chunk, ASTContext &chunkCtx) {
+    FirstPassASTConsumer pass(symbolName, options, pools[i],
+      /*matchDecls=*/true);
+    pass.matchChunk(chunk, chunkCtx);
+    pass.detach(results[i]);
+  });
+
+  llvm::TimeTraceScope timeScope("ArgStates merge");
+  for (size_t i = 0; i < chunkCount; i++) {
+    merge(results[i], pools[i]);
+  }
+}
+
+/// Match a set of declarations while the TU is being parsed, the
+/// parent map is rebuilt for the narrowed scope on the first query
+void FirstPassASTConsumer::matchScope(const std::vector<Decl*> &decls,
+ ASTContext &ctx) {
+  if (decls.empty()) {
+    return;
+  }
+  llvm::TimeTraceScope timeScope("ArgStates matchAST");
+  stream::TraversalScope scope(ctx, decls);
+  this->finder.matchAST(ctx);
+  this->profile.collect();
+}
+
+void FirstPassASTConsumer::addProfile(profile::MatcherProfile &out) const {
+  out.merge(this->profile);
+  for (const auto* callback : {&anyCallback, &refCallback, &intCallback,
+                               &strCallback, &chrCallback, &unaryCallback}) {
+    out.addMatches(callback->getID(), callback->getMatches());
+  }
 }
 
 FirstPassASTConsumer::
-FirstPassASTConsumer(std::string symbolName): matchHandler() {
+FirstPassASTConsumer(std::string symbolName,
+ const ArgStatesOptions &options, StringPool &pool, bool matchDecls):
+ matchHandler(options, pool),
+ anyCallback(matchHandler,   &FirstPassMatcher::handleAnyMatch,
+   "FirstPass/ANY"),
+ refCallback(matchHandler,   &FirstPassMatcher::handleRefMatch,
+   "FirstPass/REF"),
+ intCallback(matchHandler,   &FirstPassMatcher::handleIntMatch,
+   "FirstPass/INT"),
+ strCallback(matchHandler,   &FirstPassMatcher::handleStrMatch,
+   "FirstPass/STR"),
+ chrCallback(matchHandler,   &FirstPassMatcher::handleChrMatch,
+   "FirstPass/CHR"),
+ unaryCallback(matchHandler, &FirstPassMatcher::handleUnaryMatch,
+   "FirstPass/UNARY"),
+ finder(profile.getFinderOptions(!options.profileDir.empty())) {
+  llvm::TimeTraceScope timeScope("ArgStates matchers");
+  addMatchers(this->finder, symbolName, options, matchDecls,
+      {&anyCallback, &refCallback, &intCallback, &strCallback, &chrCallback,
+       &unaryCallback});
+}
+
+void FirstPassASTConsumer::addMatchers(MatchFinder &finder,
+ const std::string &symbolName, const ArgStatesOptions &options,
+ bool matchDecls, const Callbacks &callbacks) {
   // The first child of a call expression is a declRefExpr to the
   // function being invoked
   //
@@ -229,21 +428,19 @@ FirstPassASTConsumer(std::string symbolName): matchHandler() {
   //        CALL_EXPR
   //
   // Testcase: XML_SetBase in xmlwf/xmlfile.c
-  const auto isArgumentOfCall = hasAncestor(
-      callExpr(callee(
-          functionDecl(hasName(symbolName)
-          ).bind("FNC")
+  const auto targetCall = callExpr(callee(
+          functionDecl(hasName(symbolName))
           ),
       unless(hasParent(compoundStmt(hasParent(functionDecl()))))
-  ).bind("CALL"));
+  );
+  const auto isArgumentOfCall = hasAncestor(targetCall.bind("CALL"));
 
   // Note that we exclude DeclRefExpr nodes which have a MemberExpr as an
   // ancestor, e.g. arguments on the form 'dtd->pool'. These expressions
   // are matched separately as MemberExpr to retrieve '->pool' rather than 'dtd'
   const auto declRefMatcher = declRefExpr(to(
     declaratorDecl()),
-    unless(hasAncestor(memberExpr())),
-    isArgumentOfCall
+    unless(hasAncestor(memberExpr()))
   ).bind("REF");
 
   // We need the literals to be direct descendants
@@ -251,16 +448,13 @@ FirstPassASTConsumer(std::string symbolName): matchHandler() {
   // larger expressions, e.g. 'foo + 6'
   // For now, any literal that is not a direct descendent of the call will be
   // considered an undet() value
-  const auto intMatcher     =
-    integerLiteral(isArgumentOfCall).bind(LITERAL[INT]);
-  const auto stringMatcher  =
-    stringLiteral(isArgumentOfCall).bind(LITERAL[STR]);
-  const auto charMatcher    =
-    characterLiteral(isArgumentOfCall).bind(LITERAL[CHR]);
+  const auto intMatcher     = integerLiteral().bind(LITERAL[INT]);
+  const auto stringMatcher  = stringLiteral().bind(LITERAL[STR]);
+  const auto charMatcher    = characterLiteral().bind(LITERAL[CHR]);
 
   // Calls to 'sizeof()' and 'alignof()', which are both compile time constants,
   // are matched with this node type
-  const auto unaryExprMatcher   = unaryExprOrTypeTraitExpr(isArgumentOfCall)
+  const auto unaryExprMatcher   = unaryExprOrTypeTraitExpr()
                                                           .bind(LITERAL[UNARY]);
 
   // Note, for a sound solution we cannot exclude any calls (except those that
@@ -268,7 +462,7 @@ FirstPassASTConsumer(std::string symbolName): matchHandler() {
   // that matches any argument formation for each parameter, if this matcher
   // is ever filled with something that we cannot handle (i.e. not a literal)
   // then the parameter is nondet().
-  const auto anyMatcher     = expr(isArgumentOfCall).bind("ANY");
+  const auto anyMatcher     = expr().bind("ANY");
 
   // Matchers are executed in the _order that they are added to the finder_
   // This does not infer that the anyMatcher will go through ALL nodes before
@@ -279,200 +473,273 @@ FirstPassASTConsumer(std::string symbolName): matchHandler() {
   // With this in mind we can always assume that an argState entry exists
   // for a literal match since the anyMatcher will have created
   // one during its visit
-  this->finder.addMatcher(anyMatcher,     &(this->matchHandler));
+  //
+  // With -spelled-only, every matcher ignores implicit nodes and template
+  // instantiations, the parent map used in the handlers is unaffected
+  //
+  // When matching a chunk of declarations, the matchers instead descend
+  // from each declaration (and -spelled-only is not supported)
+  //
+  // Every node is matched bottom-up, i.e. each node checks if it has
+  // an ancestor call to the symbol. With -params, the matchers are instead
+  // rooted at the call and only search the arguments of the selected
+  // parameters (see forEachSelectedArgument()), the finder still walks
+  // the whole AST to find the calls. Each argument is matched as written,
+  // without skipping casts, so the handlers see the same bound nodes in
+  // both cases.
+  const auto traversal = options.spelledOnly ?
+    TK_IgnoreUnlessSpelledInSource : TK_AsIs;
+
+  const auto inArgumentOfCall = [&](const StatementMatcher &node)
+   -> StatementMatcher {
+    if (options.params.empty()) {
+      return stmt(node, isArgumentOfCall);
+    }
+    return callExpr(targetCall, forEachSelectedArgument(&options.params,
+          expr(eachOf(node, forEachDescendant(node)))
+    )).bind("CALL");
+  };
+
+  const auto addMatcher = [&](const StatementMatcher &node,
+   MatchFinder::MatchCallback *callback) {
+    const auto matcher = inArgumentOfCall(node);
+    if (matchDecls) {
+      finder.addMatcher(decl(forEachDescendant(matcher)), callback);
+    } else {
+      finder.addMatcher(traverse(traversal, matcher), callback);
+    }
+  };
 
-  this->finder.addMatcher(declRefMatcher, &(this->matchHandler));
-  this->finder.addMatcher(intMatcher,     &(this->matchHandler));
-  this->finder.addMatcher(stringMatcher,  &(this->matchHandler));
-  this->finder.addMatcher(charMatcher,    &(this->matchHandler));
-  this->finder.addMatcher(unaryExprMatcher,    &(this->matchHandler));
-}
+  addMatcher(anyMatcher,       callbacks.any);
 
+  addMatcher(declRefMatcher,   callbacks.ref);
+  addMatcher(intMatcher,       callbacks.intLiteral);
+  addMatcher(stringMatcher,    callbacks.strLiteral);
+  addMatcher(charMatcher,      callbacks.chrLiteral);
+  addMatcher(unaryExprMatcher, callbacks.unary);
+}
 
-void FirstPassMatcher::
-run(const MatchFinder::MatchResult &result) {
-  // The idea:
-  // Determine what types of arguments are passed to the function
-  // For literal and NULL arguments, we add their value to the state space
-  //
-  // For declrefs, we save the names of each argument and query for
-  // all references to them before the call (in the same enclosing function)
-  // in the next pass (not implemented)
-  // The key cases we want to detect are
-  //   1. When literals are passed
-  //   2. When an uninitialized (null) variable is passed
-  //   3. When a variable is assigned a literal value (and remains unchanged)
-  // We skip considering struct fields (MemberExpr) for now
 
+/// Common setup for every match, returns the matched call.
+///
+/// The idea:
+/// Determine what types of arguments are passed to the function
+/// For literal and NULL arguments, we add their value to the state space
+///
+/// For declrefs, we save the names of each argument and query for
+/// all references to them before the call (in the same enclosing function)
+/// in the next pass (not implemented)
+/// The key cases we want to detect are
+///   1. When literals are passed
+///   2. When an uninitialized (null) variable is passed
+///   3. When a variable is assigned a literal value (and remains unchanged)
+/// We skip considering struct fields (MemberExpr) for now
+const CallExpr* FirstPassMatcher::
+beginMatch(const MatchFinder::MatchResult &result) {
   // Holds information on the actual source code
   this->srcMgr = result.SourceManager;
 
   // Holds contextual information about the AST, this allows
   // us to determine e.g. the parents of a matched node
   this->ctx = result.Context;
-  this->nodeMap = result.Nodes.getMap();
 
-  // ::run() is invoked anew for every match, the getNodes() calls
-  // that get populated depend on the binds() defined for each matcher
-  // i.e. all of the matches will have CALL available since the
+  // All of the matches will have CALL available since the
   // 'isArgumentOfCall' is included in every matcher
-  const auto *call       = result.Nodes.getNodeAs<CallExpr>("CALL");
-  const auto *fnc        = result.Nodes.getNodeAs<FunctionDecl>("FNC");
-  assert(call && fnc);
+  const auto *call = result.Nodes.getNodeAs<CallExpr>("CALL");
+  assert(call && call->getDirectCallee());
 
-  const auto *declRef    = result.Nodes.getNodeAs<DeclRefExpr>("REF");
-  const auto *anyArg     = result.Nodes.getNodeAs<Expr>("ANY");
+  // The outer consumer names the output file after the file of the
+  // last matched call, see getFilename()
+  this->lastCallLoc = call->getEndLoc();
 
-  const auto *intLiteral = result.Nodes.getNodeAs<IntegerLiteral>(LITERAL[INT]);
-  const auto *strLiteral = result.Nodes.getNodeAs<StringLiteral>(LITERAL[STR]);
-  const auto *chrLiteral =
-    result.Nodes.getNodeAs<CharacterLiteral>(LITERAL[CHR]);
-  const auto *unaryExpr  =
-    result.Nodes.getNodeAs<UnaryExprOrTypeTraitExpr>(LITERAL[UNARY]);
+  return call;
+}
+
+/// The filename (basename) of the current TU so that the outer consumer
+/// knows what filename to use for the output file
+std::string FirstPassMatcher::getFilename() {
+  if (this->lastCallLoc.isInvalid()) {
+    return "";
+  }
+  auto filepath = srcMgr->getFilename(this->lastCallLoc);
+  return filepath.substr(filepath.find_last_of("/\\") + 1).str();
+}
+
+/***** First matching stage ****/
+// Creates a set of all leaf nodes that need to be inspected for
+// each argument
+void FirstPassMatcher::
+handleAnyMatch(const MatchFinder::MatchResult &result) {
+  const auto *call   = this->beginMatch(result);
+  const auto *anyArg = result.Nodes.getNodeAs<Expr>("ANY");
+  if (this->isDuplicate(call, anyArg)) {
+    return;
+  }
+
+  const auto name = anyArg->getStmtClassName();
+  util::dumpMatch("ANY", name, 1, anyArg->getEndLoc());
 
   // To correlate the arguments that we match against to parameters in the
   // function call we need to traverse the call expression and pair the
-  // arguments with the Parms from the FNC
-
-  // Extract the filename (basename) of the current TU so that
-  // the outer consumer knows what filename to use for the output file
-  auto filepath = srcMgr->getFilename(call->getEndLoc());
-  this->filename = filepath.substr(filepath.find_last_of("/\\") + 1);
-
-
-  /***** First matching stage ****/
-  // Creates a set of all node IDs that need to be inspected for
-  // each argument
-  if (anyArg) {
-    const auto name = anyArg->getStmtClassName();
-    util::dumpMatch("ANY", name, 1, this->srcMgr, anyArg->getEndLoc());
-
-    // Determine which parameter the leaf node corresponds to
-    auto callPath = std::vector<DynTypedNode>();
-    const auto param = this->getParam(call, callPath, "ANY");
-    const std::string paramName  = std::get<0>(param);
-    const int paramIndex         = std::get<1>(param);
-
-    // Skip matches which correspond to the called function name
-    // ('-1'th node of every call)
-    if (paramName == fnc->getName()){
-      return;
-    }
+  // arguments with the Parms from the callee
+  // Determine which parameter the leaf node corresponds to
+  const auto param = this->getParam(call, anyArg);
+  const StringRef paramName    = std::get<0>(param);
+  const int paramIndex         = std::get<1>(param);
 
-    if (paramName.size()==0 && paramIndex == -1){
-      PRINT_ERR("ANY> Failed to determine param for: ");
-      anyArg->dumpColor();
-    } else {
-      auto leafStmt = util::getFirstLeaf(anyArg, ctx);
-
-      // If the array contains fewer elements than the paramIndex
-      // insert dummy elements starting from the first uninitialized position
-      // We cannot simply insert a parameter at the current last position
-      // since there is no guarantee that we encounter the function
-      // arguments in order, i.e. the first match could be the fifth argument
-      while ((int)this->argumentStates.size() <= paramIndex) {
-        struct ArgState argState = {
-          .ids = std::set<uint64_t>(),
-          .states = std::set<variants>(),
-        };
-
-        // Set the paramName once we reach the correct index
-        if ((int)this->argumentStates.size()==paramIndex){
-          argState.paramName = paramName;
-        }
-
-        this->argumentStates.push_back(argState);
-      }
+  // Skip matches which correspond to the called function name
+  // ('-1'th node of every call)
+  if (paramName == call->getDirectCallee()->getName()){
+    return;
+  }
 
+  if (paramName.size()==0 && paramIndex == -1){
+    PRINT_ERR("ANY> Failed to determine param for: ");
+    anyArg->dumpColor();
+  } else {
+    auto leafStmt = util::getFirstLeaf(anyArg, ctx);
 
-      // Set the argument type
-      const auto className = leafStmt->getStmtClassName();
-      if (NodeTypes.find(className) != NodeTypes.end()){
-        this->argumentStates[paramIndex].type = NodeTypes.at(className);
-      } else {
-        PRINT_ERR("ANY> Unhandled leaf node type: " << className);
+    // If the array contains fewer elements than the paramIndex
+    // insert dummy elements starting from the first uninitialized position
+    // We cannot simply insert a parameter at the current last position
+    // since there is no guarantee that we encounter the function
+    // arguments in order, i.e. the first match could be the fifth argument
+    while ((int)this->argumentStates.size() <= paramIndex) {
+      ArgState argState;
+
+      // Set the paramName once we reach the correct index
+      if ((int)this->argumentStates.size()==paramIndex){
+        argState.paramName = paramName.str();
       }
 
-      // Save the nodeID of the leaf stmt for this match
-      uint64_t stmtID = leafStmt->getID(*ctx);
-      this->argumentStates[paramIndex].ids.insert(stmtID);
+      this->argumentStates.push_back(std::move(argState));
+    }
 
-      PRINT_INFO("ANY> " << paramName << " "<< className << ": "
-          << leafStmt->getID(*ctx) \
-          << " (" << this->argumentStates[paramIndex].ids.size() << ")" );
+    // Set the argument type
+    const auto stateType = getStateType(leafStmt->getStmtClass());
+    if (stateType){
+      this->argumentStates[paramIndex].type = *stateType;
+      this->argumentStates[paramIndex].hasType = true;
+    } else {
+      PRINT_ERR("ANY> Unhandled leaf node type: "
+          << leafStmt->getStmtClassName());
     }
+
+    // Save the leaf stmt for this match
+    this->argumentStates[paramIndex].ids.insert(leafStmt);
+
+    PRINT_TRACE("ANY> " << paramName << " "<< leafStmt->getStmtClassName()
+        << ": " << leafStmt->getID(*ctx) \
+        << " (" << this->argumentStates[paramIndex].ids.size() << ")" );
   }
-  /***** Second matching stage ****/
-  else if (declRef) {
-    // This includes a match for the actual function token (index -1)
-    const auto name = declRef->getDecl()->getName();
-    util::dumpMatch("REF", name, 1, this->srcMgr, declRef->getEndLoc());
+}
 
-    // During the second pass we must be able to identify
-    //  * the enclosing function
-    //  * the callee
-    //  * the argument name
-    //  for every reference that we encounter in the 1st pass
+/***** Second matching stage ****/
+void FirstPassMatcher::
+handleRefMatch(const MatchFinder::MatchResult &result) {
+  const auto *call    = this->beginMatch(result);
+  const auto *declRef = result.Nodes.getNodeAs<DeclRefExpr>("REF");
+  if (this->isDuplicate(call, declRef)) {
+    return;
+  }
 
-    auto callPath = std::vector<DynTypedNode>();
-    auto param    = this->getParam(call, callPath, "REF");
-    const std::string paramName  = std::get<0>(param);
-    const int paramIndex         = std::get<1>(param);
+  // This includes a match for the actual function token (index -1)
+  const auto name = declRef->getDecl()->getName();
+  util::dumpMatch("REF", name, 1, declRef->getEndLoc());
 
-    if (paramName == fnc->getName()){
-      return;
-    }
+  // During the second pass we must be able to identify
+  //  * the enclosing function
+  //  * the callee
+  //  * the argument name
+  //  for every reference that we encounter in the 1st pass
 
-    // Set all declrefs as nondet()
-    while ((int)this->argumentStates.size() <= paramIndex) {
-      struct ArgState argState = {
-        .ids = std::set<uint64_t>(),
-        .states = std::set<variants>(),
-      };
+  auto param    = this->getParam(call, declRef);
+  const StringRef paramName    = std::get<0>(param);
+  const int paramIndex         = std::get<1>(param);
 
-      // Set specific values once we reach the correct index
-      if ((int)this->argumentStates.size()==paramIndex){
-        argState.paramName = paramName;
-        argState.isNonDet = true;
-      }
+  if (paramName == call->getDirectCallee()->getName()){
+    return;
+  }
+
+  // Set all declrefs as nondet()
+  while ((int)this->argumentStates.size() <= paramIndex) {
+    ArgState argState;
 
-      this->argumentStates.push_back(argState);
+    // Set specific values once we reach the correct index
+    if ((int)this->argumentStates.size()==paramIndex){
+      argState.paramName = paramName.str();
+      argState.isNonDet = true;
     }
 
+    this->argumentStates.push_back(std::move(argState));
   }
-  else if (intLiteral) {
-    const auto value =  intLiteral->getValue().getLimitedValue();
-    util::dumpMatch(LITERAL[INT], value, 1, this->srcMgr,
-        intLiteral->getLocation());
-    this->handleLiteralMatch(value, INT, call, intLiteral);
-  }
-  else if (strLiteral) {
-    const auto value =  std::string(strLiteral->getString());
-    util::dumpMatch(LITERAL[STR], value, 1, this->srcMgr,
-        strLiteral->getEndLoc());
-    this->handleLiteralMatch(value, STR, call, strLiteral);
-  }
-  else if (chrLiteral) {
-    const auto value =  chrLiteral->getValue();
-    util::dumpMatch(LITERAL[CHR], value, 1, this->srcMgr,
-        chrLiteral->getLocation());
-    this->handleLiteralMatch(value, CHR, call, chrLiteral);
-  }
-  else if (unaryExpr) {
-    // Matches alignof() and sizeof(), instead of inserting these values
-    // as text we evaluate them as integer values
-    //  https://clang.llvm.org/doxygen/classclang_1_1UnaryExprOrTypeTraitExpr.html#details
-    Expr::EvalResult res;
-    unaryExpr->EvaluateAsInt(res, *ctx);
-    if (res.HasSideEffects || res.HasUndefinedBehavior) {
-      util::dumpMatch(LITERAL[UNARY], "FAILED to evaluate", 1, this->srcMgr,
-          unaryExpr->getEndLoc());
-    } else {
-      const auto value = res.Val.getInt().getLimitedValue();
-      util::dumpMatch(LITERAL[UNARY], value, 1, this->srcMgr,
-          unaryExpr->getEndLoc());
-      this->handleLiteralMatch(value, UNARY, call, unaryExpr);
-    }
+}
+
+void FirstPassMatcher::
+handleIntMatch(const MatchFinder::MatchResult &result) {
+  const auto *call       = this->beginMatch(result);
+  const auto *intLiteral = result.Nodes.getNodeAs<IntegerLiteral>(LITERAL[INT]);
+  if (this->isDuplicate(call, intLiteral)) {
+    return;
+  }
+
+  const auto value =  intLiteral->getValue().getLimitedValue();
+  util::dumpMatch(LITERAL[INT], value, 1, intLiteral->getLocation());
+  this->handleLiteralMatch(value, INT, call, intLiteral);
+}
+
+void FirstPassMatcher::
+handleStrMatch(const MatchFinder::MatchResult &result) {
+  const auto *call       = this->beginMatch(result);
+  const auto *strLiteral = result.Nodes.getNodeAs<StringLiteral>(LITERAL[STR]);
+  if (this->isDuplicate(call, strLiteral)) {
+    return;
+  }
+
+  // References the literal data in the AST, no copy is made unless the
+  // value has not been seen before
+  const StringRef value = strLiteral->getString();
+  util::dumpMatch(LITERAL[STR], value, 1, strLiteral->getEndLoc());
+  this->handleLiteralMatch(value, STR, call, strLiteral);
+}
+
+void FirstPassMatcher::
+handleChrMatch(const MatchFinder::MatchResult &result) {
+  const auto *call       = this->beginMatch(result);
+  const auto *chrLiteral =
+    result.Nodes.getNodeAs<CharacterLiteral>(LITERAL[CHR]);
+  if (this->isDuplicate(call, chrLiteral)) {
+    return;
   }
+
+  const auto value =  chrLiteral->getValue();
+  util::dumpMatch(LITERAL[CHR], value, 1, chrLiteral->getLocation());
+  this->handleLiteralMatch(value, CHR, call, chrLiteral);
 }
 
+void FirstPassMatcher::
+handleUnaryMatch(const MatchFinder::MatchResult &result) {
+  const auto *call      = this->beginMatch(result);
+  const auto *unaryExpr =
+    result.Nodes.getNodeAs<UnaryExprOrTypeTraitExpr>(LITERAL[UNARY]);
+  if (this->isDuplicate(call, unaryExpr)) {
+    return;
+  }
+
+  // Matches alignof() and sizeof(), instead of inserting these values
+  // as text we evaluate them as integer values
+  //  https://clang.llvm.org/doxygen/classclang_1_1UnaryExprOrTypeTraitExpr.html#details
+  Expr::EvalResult res;
+  bool evaluated = false;
+  if (!unaryExpr->isValueDependent()) {
+    evaluated = unaryExpr->EvaluateAsInt(res, *ctx);
+  }
+  if (!evaluated || res.HasSideEffects || res.HasUndefinedBehavior) {
+    util::dumpMatch(LITERAL[UNARY], "FAILED to evaluate", 1,
+        unaryExpr->getEndLoc());
+  } else {
+    const auto value = res.Val.getInt().getLimitedValue();
+    util::dumpMatch(LITERAL[UNARY], value, 1, unaryExpr->getEndLoc());
+    this->handleLiteralMatch(value, UNARY, call, unaryExpr);
+  }
+}
@@ -0,0 +1,177 @@
+#include "Log.hpp"
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/Signals.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace logging {
+  std::atomic<int> currentLevel{static_cast<int>(Level::Error)};
+
+  // Number of entries in the trace buffer (~4 MiB), allocated on the
+  // first trace
+  static constexpr uint64_t TRACE_CAPACITY = 1 << 15;
+
+  // The 'seq' of an entry that is claimed by a writer or by a flush
+  static constexpr uint64_t TRACE_BUSY = UINT64_MAX;
+
+  struct TraceEntry {
+    // Ticket of the entry plus one, set once the entry has been written.
+    // The other fields are only accessed by the thread that has swapped
+    // in TRACE_BUSY.
+    std::atomic<uint64_t> seq{0};
+    const char* type;
+    int pass;
+    clang::SourceLocation loc;
+    uint8_t size;
+    char msg[TRACE_MSG_SIZE];
+  };
+
+  static std::atomic<uint64_t> nextTicket{0};
+  // Entries that were dropped since their slot was claimed by another
+  // thread, see trace()
+  static std::atomic<uint64_t> dropped{0};
+  static std::atomic<TraceEntry*> entries{nullptr};
+
+  /// The buffer is allocated once and never freed, an entry could
+  /// otherwise be written to it after the plugin has been unloaded
+  static TraceEntry* getEntries() {
+    TraceEntry* buffer = entries.load(std::memory_order_acquire);
+    if (buffer != nullptr) {
+      return buffer;
+    }
+    auto allocated = std::make_unique<TraceEntry[]>(TRACE_CAPACITY);
+    if (entries.compare_exchange_strong(buffer, allocated.get(),
+          std::memory_order_acq_rel)) {
+      return allocated.release();
+    }
+    // Allocated by another thread in the meantime
+    return buffer;
+  }
+
+  bool parseLevel(llvm::StringRef str, Level &level) {
+    const auto parsed = llvm::StringSwitch<std::optional<Level>>(str)
+      .Case("error", Level::Error)
+      .Case("warn", Level::Warn)
+      .Case("info", Level::Info)
+      .Case("trace", Level::Trace)
+      .Default(std::nullopt);
+    if (!parsed) {
+      return false;
+    }
+    level = *parsed;
+    return true;
+  }
+
+  /// Flush what is left in the trace buffer when the process crashes or
+  /// exits before the end of the TU. Locations are not resolved, the
+  /// SourceManager may already be gone.
+  static void flushOnCrash(void*) {
+    flushTraces(nullptr);
+  }
+
+  static void flushOnExit() {
+    flushTraces(nullptr);
+  }
+
+  void init(std::optional<Level> fromArgs) {
+    Level level = Level::Error;
+    if (fromArgs) {
+      level = *fromArgs;
+    } else if (getenv(DEBUG_ENV) != nullptr) {
+      level = Level::Trace;
+    }
+    currentLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+
+    if (level == Level::Trace) {
+      static std::once_flag registered;
+      std::call_once(registered, [] {
+        llvm::sys::AddSignalHandler(flushOnCrash, nullptr);
+        std::atexit(flushOnExit);
+      });
+    }
+  }
+
+  void trace(const char* type, int pass, clang::SourceLocation loc,
+      llvm::StringRef msg) {
+    TraceEntry* buffer = getEntries();
+    const uint64_t ticket = nextTicket.fetch_add(1, std::memory_order_relaxed);
+    TraceEntry &entry = buffer[ticket % TRACE_CAPACITY];
+
+    // Claim the slot, it is busy if a writer that wrapped around the
+    // buffer or a flush is using it. The entry is dropped rather than
+    // waited on, a crash flush could otherwise wait on its own thread.
+    uint64_t seq = entry.seq.load(std::memory_order_relaxed);
+    if (seq == TRACE_BUSY ||
+        !entry.seq.compare_exchange_strong(seq, TRACE_BUSY,
+          std::memory_order_acquire, std::memory_order_relaxed)) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    entry.type = type;
+    entry.pass = pass;
+    entry.loc = loc;
+    entry.size = static_cast<uint8_t>(std::min(msg.size(), TRACE_MSG_SIZE));
+    memcpy(entry.msg, msg.data(), entry.size);
+    entry.seq.store(ticket + 1, std::memory_order_release);
+  }
+
+  void flushTraces(const clang::SourceManager* srcMgr) {
+    TraceEntry* buffer = entries.load(std::memory_order_acquire);
+    const uint64_t end = nextTicket.load(std::memory_order_acquire);
+    if (buffer == nullptr || end == 0) {
+      return;
+    }
+    const uint64_t begin = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+    if (begin > 0) {
+      llvm::errs() << "\033[33m!>\033[0m " << begin
+                   << " trace entries were overwritten\n";
+    }
+
+    const uint64_t droppedCount = dropped.exchange(0,
+        std::memory_order_relaxed);
+    if (droppedCount > 0) {
+      llvm::errs() << "\033[33m!>\033[0m " << droppedCount
+                   << " trace entries were dropped\n";
+    }
+
+    for (uint64_t ticket = begin; ticket < end; ticket++) {
+      TraceEntry &slot = buffer[ticket % TRACE_CAPACITY];
+      // Skips entries that are being written or that do not match their
+      // ticket. The entry is copied out and the slot released as consumed.
+      uint64_t seq = ticket + 1;
+      if (!slot.seq.compare_exchange_strong(seq, TRACE_BUSY,
+            std::memory_order_acquire, std::memory_order_relaxed)) {
+        continue;
+      }
+      TraceEntry entry;
+      entry.type = slot.type;
+      entry.pass = slot.pass;
+      entry.loc = slot.loc;
+      entry.size = slot.size;
+      memcpy(entry.msg, slot.msg, slot.size);
+      slot.seq.store(0, std::memory_order_release);
+      const llvm::StringRef msg(entry.msg, entry.size);
+
+      if (entry.type == nullptr) {
+        llvm::errs() << "\033[34m!>\033[0m " << msg << "\n";
+        continue;
+      }
+      llvm::errs() << "\033[35m" << entry.pass << "\033[0m: "
+                   << entry.type << "> ";
+      if (srcMgr != nullptr && entry.loc.isValid()) {
+        srcMgr->getFileLoc(entry.loc).print(llvm::errs(), *srcMgr);
+      } else {
+        llvm::errs() << "<unknown>";
+      }
+      llvm::errs() << " " << msg << "\n";
+    }
+    nextTicket.store(0, std::memory_order_release);
+  }
+}
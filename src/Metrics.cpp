@@ -0,0 +1,150 @@
+#include "Metrics.hpp"
+#include "Log.hpp"
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ParentMapContext.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdlib>
+#include <sys/resource.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace metrics {
+  Record::Record(std::string path, llvm::StringRef plugin)
+    : path(std::move(path)), plugin(plugin.str()) {}
+
+  void Record::setLabel(llvm::StringRef name, llvm::StringRef value) {
+    this->labels[name.str()] = value.str();
+  }
+
+  void Record::add(llvm::StringRef counter, uint64_t count) {
+    this->counters[counter.str()] += count;
+  }
+
+  void Record::addMatches(const llvm::StringMap<uint64_t> &matches) {
+    for (const auto &count : matches) {
+      this->matches[count.getKey().str()] += count.getValue();
+    }
+  }
+
+  void Record::addTime(llvm::StringRef phase, double seconds) {
+    this->phases[phase.str()] += seconds;
+  }
+
+  void Record::addMemory(llvm::StringRef name, uint64_t bytes) {
+    this->memory[name.str()] += bytes;
+  }
+
+  bool Record::append() const {
+    // The line is assembled first and written with one write()
+    std::string line;
+    llvm::raw_string_ostream s(line);
+    llvm::json::OStream json(s);
+
+    json.object([&] {
+      json.attribute("plugin", this->plugin);
+      json.attributeObject("labels", [&] {
+        for (const auto &label : this->labels) {
+          json.attribute(label.first, label.second);
+        }
+      });
+      json.attributeObject("counters", [&] {
+        for (const auto &counter : this->counters) {
+          json.attribute(counter.first, static_cast<int64_t>(counter.second));
+        }
+      });
+      json.attributeObject("matches", [&] {
+        for (const auto &count : this->matches) {
+          json.attribute(count.first, static_cast<int64_t>(count.second));
+        }
+      });
+      json.attributeObject("phases", [&] {
+        for (const auto &phase : this->phases) {
+          json.attribute(phase.first, phase.second);
+        }
+      });
+      if (!this->memory.empty()) {
+        json.attributeObject("memory", [&] {
+          for (const auto &bytes : this->memory) {
+            json.attribute(bytes.first, static_cast<int64_t>(bytes.second));
+          }
+        });
+      }
+    });
+    s << "\n";
+    s.flush();
+
+    std::error_code ec;
+    llvm::raw_fd_ostream f(this->path, ec, llvm::sys::fs::OF_Append);
+    if (ec) {
+      PRINT_ERR("Failed to open " << this->path << ": " << ec.message());
+      return false;
+    }
+    f.SetUnbuffered();
+    f << line;
+
+    const bool failed = f.has_error();
+    if (failed) {
+      PRINT_ERR("Failed to write " << this->path << ": "
+                << f.error().message());
+      f.clear_error();
+    }
+    return !failed;
+  }
+
+  std::string getPath(llvm::StringRef fromArgs) {
+    if (!fromArgs.empty()) {
+      return fromArgs.str();
+    }
+    const char* path = getenv(METRICS_FILE_ENV);
+    return path != nullptr ? std::string(path) : std::string();
+  }
+
+  std::optional<uint64_t> getHeapAllocated() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || \
+    (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return std::nullopt;
+#endif
+  }
+
+  void addASTMemory(Record &record, clang::ASTContext &ctx) {
+    const auto &srcMgr = ctx.getSourceManager();
+    const auto buffers = srcMgr.getMemoryBufferSizes();
+
+    record.addMemory("ast", ctx.getASTAllocatedMemory());
+    record.addMemory("sideTables", ctx.getSideTableAllocatedMemory());
+    record.addMemory("sourceManagerContentCache",
+        srcMgr.getContentCacheSize());
+    record.addMemory("sourceManagerDataStructures",
+        srcMgr.getDataStructureSizes());
+    record.addMemory("sourceManagerMallocBuffers", buffers.malloc_bytes);
+    record.addMemory("sourceManagerMmapBuffers", buffers.mmap_bytes);
+  }
+
+  void addParentMapMemory(Record &record, clang::ASTContext &ctx) {
+    const auto before = getHeapAllocated();
+    // The parent map for the entire TU is created on the first query
+    ctx.getParents(*ctx.getTranslationUnitDecl());
+    const auto after = getHeapAllocated();
+
+    if (before && after && *after >= *before) {
+      record.addMemory("parentMap", *after - *before);
+    }
+  }
+
+  void addPeakRSS(Record &record) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      // Given in kilobytes on Linux
+      record.addMemory("peakRSS", static_cast<uint64_t>(usage.ru_maxrss) * 1024);
+    }
+  }
+}
@@ -0,0 +1,69 @@
+#include "Output.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace output {
+  /// Write every span, writev() can write less than requested and takes
+  /// at most IOV_MAX spans per call
+  static bool writeSpans(int fd, std::vector<iovec> &spans) {
+    size_t first = 0;
+    while (first < spans.size()) {
+      const int count = (int)std::min(spans.size() - first, (size_t)IOV_MAX);
+      ssize_t written = writev(fd, &spans[first], count);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      // Skip the spans that were written completely and advance
+      // into the first one that was not
+      while (first < spans.size() && (size_t)written >= spans[first].iov_len) {
+        written -= spans[first].iov_len;
+        first++;
+      }
+      if (first < spans.size()) {
+        spans[first].iov_base = (char*)spans[first].iov_base + written;
+        spans[first].iov_len -= written;
+      }
+    }
+    return true;
+  }
+
+  bool writeEdited(int fd, llvm::StringRef buffer, std::vector<Edit> &edits) {
+    std::stable_sort(edits.begin(), edits.end(),
+        [](const Edit &lhs, const Edit &rhs) {
+          return lhs.offset < rhs.offset;
+        });
+
+    std::vector<iovec> spans;
+    spans.reserve(2*edits.size() + 1);
+    auto addSpan = [&spans](const char* data, size_t size) {
+      if (size > 0) {
+        spans.push_back({const_cast<char*>(data), size});
+      }
+    };
+
+    size_t offset = 0;
+    for (const auto &edit : edits) {
+      if (edit.offset < offset ||
+          (size_t)edit.offset + edit.length > buffer.size()) {
+        continue;
+      }
+      addSpan(buffer.data() + offset, edit.offset - offset);
+      addSpan(edit.text.data(), edit.text.size());
+      offset = edit.offset + edit.length;
+    }
+    addSpan(buffer.data() + offset, buffer.size() - offset);
+
+    return writeSpans(fd, spans);
+  }
+}
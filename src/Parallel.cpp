@@ -0,0 +1,266 @@
+#include "Parallel.hpp"
+#include "Log.hpp"
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+using namespace clang;
+
+namespace parallel {
+  // More chunks than threads, chunks can differ a lot in how many
+  // matches they contain
+  static constexpr unsigned CHUNKS_PER_JOB = 4;
+
+  unsigned getMaxJobs(const ASTContext &ctx, unsigned jobs) {
+    const uint64_t copySize = std::max<uint64_t>(1,
+        ctx.getASTAllocatedMemory() + ctx.getSideTableAllocatedMemory());
+    const uint64_t copies = MAX_COPY_MEMORY / copySize;
+    return static_cast<unsigned>(std::min<uint64_t>(std::max(1U, jobs),
+          copies + 1));
+  }
+
+  bool canMatchConcurrently(ASTContext &ctx, unsigned jobs,
+      std::string &reason) {
+    if (getMaxJobs(ctx, jobs) <= 1) {
+      reason = "the TU is too large to copy";
+      return false;
+    }
+    if (ctx.getExternalSource() != nullptr) {
+      // Declarations from a PCH or module are deserialized on demand
+      reason = "the AST has an external source";
+      return false;
+    }
+    if (!llvm::llvm_is_multithreaded()) {
+      reason = "LLVM was built without thread support";
+      return false;
+    }
+    return true;
+  }
+
+  ContextFactory reparseFrom(const CompilerInvocation &invocation,
+      const SourceManager &srcMgr) {
+    // Only the AST is needed, the copies must not run the plugins again
+    // or write any output. The bodies are always parsed, -skip-bodies
+    // relies on the BodyFilter of the plugin which an ASTUnit does not
+    // have (its consumer would skip every body, see Skip.hpp).
+    auto base = std::make_shared<CompilerInvocation>(invocation);
+    base->getFrontendOpts().Plugins.clear();
+    base->getFrontendOpts().AddPluginActions.clear();
+    base->getFrontendOpts().PluginArgs.clear();
+    base->getFrontendOpts().SkipFunctionBodies = false;
+    base->getDependencyOutputOpts() = DependencyOutputOptions();
+
+    // Every file that has been read by the original, the buffers are
+    // owned by its SourceManager
+    using File = std::pair<std::string, llvm::MemoryBufferRef>;
+    auto files = std::make_shared<std::vector<File>>();
+    for (auto it = srcMgr.fileinfo_begin(); it != srcMgr.fileinfo_end();
+         ++it) {
+      const auto buffer = it->second->getBufferIfLoaded();
+      if (!buffer) {
+        continue;
+      }
+      llvm::SmallString<256> path(it->first->getName());
+      srcMgr.getFileManager().makeAbsolutePath(path);
+      files->emplace_back(path.str().str(), *buffer);
+    }
+
+    return [base, files]() -> std::unique_ptr<ASTUnit> {
+      auto memoryFS =
+        llvm::makeIntrusiveRefCnt<llvm::vfs::InMemoryFileSystem>();
+      for (const auto &file : *files) {
+        memoryFS->addFile(file.first, 0,
+            llvm::MemoryBuffer::getMemBuffer(file.second,
+              /*RequiresNullTerminator=*/false));
+      }
+      // A file system of its own, the working directory of the
+      // real file system is shared by the whole process
+      auto overlayFS = llvm::makeIntrusiveRefCnt<llvm::vfs::OverlayFileSystem>(
+          llvm::vfs::createPhysicalFileSystem());
+      overlayFS->pushOverlay(memoryFS);
+
+      auto copy = std::make_shared<CompilerInvocation>(*base);
+      auto fileMgr = llvm::makeIntrusiveRefCnt<FileManager>(
+          copy->getFileSystemOpts(), overlayFS);
+      // Diagnostics have already been reported for the original
+      auto diags = CompilerInstance::createDiagnostics(new DiagnosticOptions,
+          new IgnoringDiagConsumer);
+
+      return ASTUnit::LoadFromCompilerInvocation(copy,
+          std::make_shared<PCHContainerOperations>(), diags, fileMgr.get());
+    };
+  }
+
+  void prepareContext(ASTContext &ctx) {
+    // The parent map for the entire TU is created on the first query
+    ctx.getParents(*ctx.getTranslationUnitDecl());
+  }
+
+  /// The size of a declaration in characters, used to balance the chunks
+  static uint64_t getWeight(const SourceManager &srcMgr, const Decl* decl) {
+    const auto range = decl->getSourceRange();
+    if (range.isInvalid() ||
+        !range.getBegin().isFileID() || !range.getEnd().isFileID()) {
+      return 1;
+    }
+    const auto begin = srcMgr.getDecomposedLoc(range.getBegin());
+    const auto end   = srcMgr.getDecomposedLoc(range.getEnd());
+    if (begin.first != end.first || end.second < begin.second) {
+      return 1;
+    }
+    return end.second - begin.second + 1;
+  }
+
+  /// True if the bodies of 'original' and 'copy' agree. A body that the
+  /// original skipped (-skip-bodies) cannot reference any of the names
+  /// that are matched, the copy may have parsed it.
+  static bool hasSameBody(const FunctionDecl* original,
+      const FunctionDecl* copy) {
+    return original->hasSkippedBody() ||
+           original->doesThisDeclarationHaveABody() ==
+           copy->doesThisDeclarationHaveABody();
+  }
+
+  /// The declarations of a context that were written in the source, the
+  /// implicit ones (e.g. special members) can be added lazily
+  static std::vector<const Decl*> getWrittenDecls(const DeclContext* dc) {
+    std::vector<const Decl*> decls;
+    for (const auto* decl : dc->decls()) {
+      if (!decl->isImplicit()) {
+        decls.push_back(decl);
+      }
+    }
+    return decls;
+  }
+
+  /// Compares the declarations of two contexts down to the function
+  /// definitions, the bodies themselves are not compared
+  static bool isSameDecl(const Decl* original, const Decl* copy) {
+    if (original->getKind() != copy->getKind() ||
+        original->getLocation() != copy->getLocation()) {
+      return false;
+    }
+    if (const auto fn = original->getAsFunction()) {
+      return hasSameBody(fn, copy->getAsFunction());
+    }
+    const auto dc = dyn_cast<DeclContext>(original);
+    if (dc == nullptr) {
+      return true;
+    }
+    const auto originalDecls = getWrittenDecls(dc);
+    const auto copyDecls = getWrittenDecls(cast<DeclContext>(copy));
+    if (originalDecls.size() != copyDecls.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < originalDecls.size(); i++) {
+      if (!isSameDecl(originalDecls[i], copyDecls[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// A copy of the TU can only stand in for the original if it has the
+  /// same declarations at the same locations and the same function
+  /// definitions, a copy parsed with other options (e.g. one that skips
+  /// the function bodies) would miss matches
+  static bool isSameTU(ASTContext &original,
+      const std::vector<Decl*> &originalDecls, ASTContext &copy,
+      const std::vector<Decl*> &copyDecls) {
+    if (original.getSourceManager().getNextLocalOffset() !=
+        copy.getSourceManager().getNextLocalOffset() ||
+        originalDecls.size() != copyDecls.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < originalDecls.size(); i++) {
+      if (!isSameDecl(originalDecls[i], copyDecls[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  ChunkRunner::ChunkRunner(ASTContext &ctx, unsigned jobs,
+   ContextFactory factory)
+   : ctx(ctx), jobs(getMaxJobs(ctx, jobs)), factory(std::move(factory)) {
+    const auto &srcMgr = ctx.getSourceManager();
+    uint64_t totalWeight = 0;
+    std::vector<uint64_t> weights;
+
+    for (auto* decl : ctx.getTranslationUnitDecl()->decls()) {
+      this->decls.push_back(decl);
+      weights.push_back(getWeight(srcMgr, decl));
+      totalWeight += weights.back();
+    }
+
+    // Contiguous chunks of roughly equal size, the merge in chunk order
+    // then visits matches in the same order as a serial traversal
+    const uint64_t chunkCount = this->jobs * CHUNKS_PER_JOB;
+    const uint64_t target = std::max<uint64_t>(1, totalWeight / chunkCount);
+    size_t start = 0;
+    uint64_t weight = 0;
+
+    for (size_t i = 0; i < this->decls.size(); i++) {
+      weight += weights[i];
+      if (weight >= target || i + 1 == this->decls.size()) {
+        this->chunks.emplace_back(start, i + 1);
+        start = i + 1;
+        weight = 0;
+      }
+    }
+  }
+
+  void ChunkRunner::run(
+   std::function<void(size_t, Chunk, ASTContext&)> fn) {
+    // Chunks are taken in order by whichever thread is free, a worker
+    // joins once its copy of the TU has been parsed
+    std::atomic<size_t> next(0);
+    const auto matchChunks = [&](Chunk decls, ASTContext &ctx) {
+      for (size_t i = next++; i < this->chunks.size(); i = next++) {
+        const auto &chunk = this->chunks[i];
+        fn(i, decls.slice(chunk.first, chunk.second - chunk.first), ctx);
+      }
+    };
+
+    std::unique_ptr<llvm::ThreadPool> pool;
+    if (this->jobs > 1 && this->factory) {
+      pool = std::make_unique<llvm::ThreadPool>(
+          llvm::hardware_concurrency(this->jobs - 1));
+    }
+    for (unsigned w = 1; pool && w < this->jobs; w++) {
+      pool->async([&, w]() {
+        if (next >= this->chunks.size()) {
+          // Every chunk has been taken, do not parse a copy in vain
+          return;
+        }
+        auto unit = this->factory();
+        if (!unit) {
+          PRINT_WARN("Worker " << w << ": failed to parse the TU");
+          return;
+        }
+        auto &copy = unit->getASTContext();
+        const auto &tuDecls = copy.getTranslationUnitDecl()->decls();
+        const std::vector<Decl*> copyDecls(tuDecls.begin(), tuDecls.end());
+
+        if (!isSameTU(this->ctx, this->decls, copy, copyDecls)) {
+          PRINT_WARN("Worker " << w << ": the copy of the TU differs");
+          return;
+        }
+        prepareContext(copy);
+        matchChunks(copyDecls, copy);
+      });
+    }
+    matchChunks(this->decls, this->ctx);
+    if (pool) {
+      pool->wait();
+    }
+  }
+}
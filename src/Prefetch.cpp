@@ -0,0 +1,209 @@
+#include "Prefetch.hpp"
+
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace clang;
+
+namespace prefetch {
+  //---------------------------------------------------------------------------
+  // DependencyLog
+  //---------------------------------------------------------------------------
+  static std::string getAbsolutePath(const SourceManager &srcMgr,
+      llvm::StringRef name) {
+    llvm::SmallString<256> path(name);
+    srcMgr.getFileManager().makeAbsolutePath(path);
+    llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+    return path.str().str();
+  }
+
+  std::vector<std::string> DependencyLog::collect(
+      const SourceManager &srcMgr) {
+    std::vector<std::string> out;
+    const auto* mainFile = srcMgr.getFileEntryForID(srcMgr.getMainFileID());
+    if (mainFile == nullptr) {
+      return out;
+    }
+    out.push_back(getAbsolutePath(srcMgr, mainFile->getName()));
+
+    for (auto it = srcMgr.fileinfo_begin(); it != srcMgr.fileinfo_end(); ++it) {
+      // Only files that were read rather than just looked up
+      if (it->first != mainFile && it->second->getBufferIfLoaded()) {
+        out.push_back(getAbsolutePath(srcMgr, it->first->getName()));
+      }
+    }
+    std::sort(out.begin() + 1, out.end());
+    return out;
+  }
+
+  void DependencyLog::record(llvm::StringRef tu,
+      std::vector<std::string> files) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->files[tu] = std::move(files);
+  }
+
+  std::vector<std::string> DependencyLog::get(llvm::StringRef tu) const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->files.lookup(tu);
+  }
+
+  bool DependencyLog::load(llvm::StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+      return false;
+    }
+    auto json = llvm::json::parse((*buffer)->getBuffer());
+    if (!json) {
+      llvm::consumeError(json.takeError());
+      return false;
+    }
+    const auto* object = json->getAsObject();
+    if (object == nullptr) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (const auto &entry : *object) {
+      const auto* array = entry.second.getAsArray();
+      if (array == nullptr || this->files.count(entry.first)) {
+        continue;
+      }
+      std::vector<std::string> tuFiles;
+      for (const auto &file : *array) {
+        if (const auto str = file.getAsString()) {
+          tuFiles.push_back(str->str());
+        }
+      }
+      this->files[entry.first] = std::move(tuFiles);
+    }
+    return true;
+  }
+
+  bool DependencyLog::save(llvm::StringRef path) const {
+    std::error_code ec;
+    llvm::raw_fd_ostream f(path, ec);
+    if (ec) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<llvm::StringRef> tus;
+    for (const auto &entry : this->files) {
+      tus.push_back(entry.getKey());
+    }
+    std::sort(tus.begin(), tus.end());
+
+    llvm::json::OStream json(f, 2);
+    json.object([&] {
+      for (const auto tu : tus) {
+        json.attributeArray(tu, [&] {
+          for (const auto &file : this->files.lookup(tu)) {
+            json.value(file);
+          }
+        });
+      }
+    });
+    f << "\n";
+    return !f.has_error();
+  }
+
+  //---------------------------------------------------------------------------
+  // Prefetcher
+  //---------------------------------------------------------------------------
+  Prefetcher::Prefetcher(uint64_t window) : window(window) {
+    this->thread = std::thread([this] { this->run(); });
+  }
+
+  Prefetcher::~Prefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->stopped = true;
+    }
+    this->cond.notify_all();
+    this->thread.join();
+  }
+
+  size_t Prefetcher::enqueue(std::vector<std::string> files) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->queue.push_back(std::move(files));
+    this->bytes.push_back(0);
+    this->isStarted.push_back(false);
+    this->cond.notify_all();
+    return this->queue.size() - 1;
+  }
+
+  void Prefetcher::started(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (index >= this->queue.size() || this->isStarted[index]) {
+      return;
+    }
+    this->isStarted[index] = true;
+    this->inFlight -= this->bytes[index];
+    this->bytes[index] = 0;
+    this->cond.notify_all();
+  }
+
+  /// Prefetch the TUs in order, a TU is prefetched if the window has room
+  /// or if nothing is in flight. TUs that have already been started are
+  /// being read by their worker and are passed over.
+  void Prefetcher::run() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+      this->cond.wait(lock, [this] {
+        return this->stopped || (this->next < this->queue.size() &&
+               (this->inFlight < this->window || this->inFlight == 0));
+      });
+      if (this->stopped) {
+        return;
+      }
+      const size_t index = this->next++;
+      if (this->isStarted[index]) {
+        continue;
+      }
+      const auto files = this->queue[index];
+      lock.unlock();
+
+      uint64_t total = 0;
+      for (const auto &file : files) {
+        total += this->prefetch(file);
+      }
+
+      lock.lock();
+      if (!this->isStarted[index]) {
+        this->bytes[index] = total;
+        this->inFlight += total;
+      }
+    }
+  }
+
+  /// Returns the size of the file if it was not prefetched before
+  uint64_t Prefetcher::prefetch(const std::string &path) {
+    if (!this->seen.insert(path).second) {
+      return 0;
+    }
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return 0;
+    }
+    struct stat st;
+    uint64_t size = 0;
+    if (fstat(fd, &st) == 0) {
+      size = st.st_size;
+      #ifdef POSIX_FADV_WILLNEED
+      posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+      #endif
+    }
+    close(fd);
+    this->prefetchedBytes += size;
+    return size;
+  }
+}
@@ -0,0 +1,107 @@
+#include "Profile.hpp"
+#include "Log.hpp"
+
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace clang;
+
+namespace profile {
+  MatchFinder::MatchFinderOptions MatcherProfile::getFinderOptions(
+   bool enabled) {
+    MatchFinder::MatchFinderOptions options;
+    if (enabled) {
+      options.CheckProfiling.emplace(this->records);
+    }
+    return options;
+  }
+
+  void MatcherProfile::collect() {
+    for (const auto &record : this->records) {
+      this->totals[record.getKey()] += record.getValue();
+    }
+    this->records.clear();
+  }
+
+  void MatcherProfile::addMatches(llvm::StringRef label, uint64_t count) {
+    this->matches[label] += count;
+  }
+
+  void MatcherProfile::merge(const MatcherProfile &other) {
+    for (const auto &total : other.totals) {
+      this->totals[total.getKey()] += total.getValue();
+    }
+    for (const auto &count : other.matches) {
+      this->matches[count.getKey()] += count.getValue();
+    }
+  }
+
+  bool MatcherProfile::write(llvm::StringRef dir, llvm::StringRef stem,
+   llvm::StringRef tu) const {
+    llvm::SmallString<256> path(dir);
+    llvm::sys::path::append(path, stem + ".profile.json");
+
+    std::error_code ec;
+    llvm::raw_fd_ostream f(path, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      PRINT_ERR("Failed to write " << path << ": " << ec.message());
+      return false;
+    }
+
+    // Matchers without a match are not necessarily in the records
+    std::vector<llvm::StringRef> labels;
+    for (const auto &total : this->totals) {
+      labels.push_back(total.getKey());
+    }
+    for (const auto &count : this->matches) {
+      if (!this->totals.count(count.getKey())) {
+        labels.push_back(count.getKey());
+      }
+    }
+
+    const auto getTime = [&](llvm::StringRef label) {
+      const auto it = this->totals.find(label);
+      return it == this->totals.end() ? llvm::TimeRecord() : it->getValue();
+    };
+    std::sort(labels.begin(), labels.end(),
+        [&](llvm::StringRef lhs, llvm::StringRef rhs) {
+      const double lhsTime = getTime(lhs).getWallTime();
+      const double rhsTime = getTime(rhs).getWallTime();
+      return lhsTime != rhsTime ? lhsTime > rhsTime : lhs < rhs;
+    });
+
+    llvm::json::OStream json(f, 2);
+    json.object([&] {
+      json.attribute("tu", tu);
+      json.attributeArray("matchers", [&] {
+        for (const auto label : labels) {
+          const auto time = getTime(label);
+          const auto count = this->matches.lookup(label);
+          json.object([&] {
+            json.attribute("name", label);
+            json.attribute("wall", time.getWallTime());
+            json.attribute("user", time.getUserTime());
+            json.attribute("system", time.getSystemTime());
+            json.attribute("matches", static_cast<int64_t>(count));
+          });
+        }
+      });
+    });
+    f << "\n";
+    return true;
+  }
+
+  std::string getTUName(const SourceManager &srcMgr) {
+    const auto* entry = srcMgr.getFileEntryForID(srcMgr.getMainFileID());
+    if (!entry) {
+      return "unknown";
+    }
+    return llvm::sys::path::filename(entry->getName()).str();
+  }
+}
@@ -0,0 +1,210 @@
+#include "Replay.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Profile.hpp"
+
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/TarWriter.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+
+namespace replay {
+  // The overlay is relative to its own location, the real paths are given
+  // below this (non-existent) directory and stripped when it is written
+  static constexpr const char* OVERLAY_DIR = "/bundle";
+  // Replaced with the directory of the extracted bundle by replay.sh
+  static constexpr const char* BUNDLE_VAR = "@BUNDLE@";
+
+  static std::string join(const std::vector<std::string> &lines) {
+    std::string out;
+    for (const auto &line : lines) {
+      out += line + "\n";
+    }
+    return out;
+  }
+
+  std::vector<std::string> stripRecordArgs(
+      const std::vector<std::string> &args) {
+    std::vector<std::string> out;
+    for (size_t i = 0; i < args.size(); i++) {
+      if (args[i] == "-record") {
+        i++;
+        continue;
+      }
+      out.push_back(args[i]);
+    }
+    return out;
+  }
+
+  Bundle::Bundle(std::string dir, llvm::StringRef plugin,
+      const std::vector<std::string> &pluginArgs, const CompilerInstance &CI)
+    : dir(std::move(dir)), plugin(plugin.str()),
+      pluginArgs(stripRecordArgs(pluginArgs)) {
+    // A replay must not append to or overwrite the output of the recorded
+    // run, every output path is moved below $BUNDLE/out
+    for (size_t i = 0; i + 1 < this->pluginArgs.size(); i++) {
+      const llvm::StringRef arg(this->pluginArgs[i]);
+      auto &value = this->pluginArgs[i + 1];
+      if (arg == "-profile-matchers") {
+        value = std::string(BUNDLE_VAR) + "/out";
+        i++;
+      } else if (arg == "-metrics-file" || arg == "-time-trace") {
+        value = std::string(BUNDLE_VAR) + "/out/" +
+                llvm::sys::path::filename(value).str();
+        i++;
+      }
+    }
+
+    llvm::BumpPtrAllocator alloc;
+    llvm::StringSaver saver(alloc);
+    llvm::SmallVector<const char*, 64> args;
+    CI.getInvocation().generateCC1CommandLine(args,
+        [&saver](const llvm::Twine &arg) { return saver.save(arg).data(); });
+
+    // The plugin is loaded and given its arguments by replay.sh
+    for (size_t i = 0; i < args.size(); i++) {
+      const llvm::StringRef arg(args[i]);
+      if (arg == "-load" || arg == "-plugin" || arg == "-add-plugin" ||
+          arg.startswith("-plugin-arg-")) {
+        i++;
+        continue;
+      }
+      this->cc1Args.push_back(arg.str());
+    }
+
+    // Relative paths are resolved against the same directory as before
+    if (CI.getFileSystemOpts().WorkingDir.empty()) {
+      llvm::SmallString<256> cwd;
+      if (!llvm::sys::fs::current_path(cwd)) {
+        this->cc1Args.push_back("-working-directory");
+        this->cc1Args.push_back(cwd.str().str());
+      }
+    }
+
+    for (const auto &path : CI.getFrontendOpts().Plugins) {
+      if (llvm::sys::path::filename(path).contains(this->plugin)) {
+        this->pluginPath = path;
+      }
+    }
+  }
+
+  void Bundle::addPluginInput(llvm::StringRef path) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+      PRINT_ERR("Failed to record " << path << ": "
+                << buffer.getError().message());
+      return;
+    }
+    const std::string name = "inputs/" +
+      llvm::sys::path::filename(path).str();
+    this->inputs[name] = (*buffer)->getBuffer().str();
+
+    for (auto &arg : this->pluginArgs) {
+      if (arg == path) {
+        arg = std::string(BUNDLE_VAR) + "/" + name;
+      }
+    }
+  }
+
+  bool Bundle::write(const SourceManager &srcMgr) const {
+    const auto base = this->plugin + "_" + profile::getTUName(srcMgr) + "." +
+                      std::to_string(llvm::sys::Process::getProcessId());
+    llvm::SmallString<256> tarPath(this->dir);
+    llvm::sys::path::append(tarPath, base + ".tar");
+
+    if (auto ec = llvm::sys::fs::create_directories(this->dir)) {
+      PRINT_ERR("Failed to create " << this->dir << ": " << ec.message());
+      return false;
+    }
+    auto tar = llvm::TarWriter::create(tarPath, base);
+    if (!tar) {
+      PRINT_ERR("Failed to create " << tarPath << ": "
+                << llvm::toString(tar.takeError()));
+      return false;
+    }
+
+    // Diagnostics and the TU name keep referring to the original paths
+    llvm::vfs::YAMLVFSWriter overlay;
+    overlay.setOverlayDir(OVERLAY_DIR);
+    overlay.setUseExternalNames(false);
+
+    auto &fileMgr = srcMgr.getFileManager();
+    for (auto it = srcMgr.fileinfo_begin(); it != srcMgr.fileinfo_end(); ++it) {
+      // Only files that were read rather than just looked up
+      const auto buffer = it->second->getBufferIfLoaded();
+      if (!buffer) {
+        continue;
+      }
+      llvm::SmallString<256> path(it->first->getName());
+      fileMgr.makeAbsolutePath(path);
+      llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+
+      const auto name = "files" + path.str().str();
+      (*tar)->append(name, buffer->getBuffer());
+      overlay.addFileMapping(path, std::string(OVERLAY_DIR) + "/" + name);
+    }
+
+    std::string overlayYAML;
+    llvm::raw_string_ostream os(overlayYAML);
+    overlay.write(os);
+
+    (*tar)->append("overlay.yaml", os.str());
+    (*tar)->append("cc1.args", join(this->cc1Args));
+    (*tar)->append("plugin.args", join(this->pluginArgs));
+    for (const auto &input : this->inputs) {
+      (*tar)->append(input.getKey(), input.getValue());
+    }
+    (*tar)->append("replay.sh", this->getScript(base));
+
+    PRINT_INFO("Recorded " << tarPath);
+    return true;
+  }
+
+  std::string Bundle::getScript(llvm::StringRef base) const {
+    std::string script;
+    llvm::raw_string_ostream s(script);
+    s << "#!/usr/bin/env bash\n"
+      << "# Replays " << base << ", recorded with -record\n"
+      << "#  PERF    Profiler command, 'perf record -g' if unset and none\n"
+      << "#          if empty\n"
+      << "#  CLANG   The clang binary (clang)\n"
+      << "#  PLUGIN  The plugin library (" << this->pluginPath << ")\n"
+      << "set -e\n"
+      << "DIR=\"$(cd \"$(dirname \"$0\")\" && pwd)\"\n"
+      << "mkdir -p \"$DIR/out\"\n"
+      << "\n"
+      << "mapfile -t CC1 < \"$DIR/cc1.args\"\n"
+      << "PLUGIN_ARGS=()\n"
+      << "while IFS= read -r arg; do\n"
+      << "  PLUGIN_ARGS+=(-plugin-arg-" << this->plugin
+      << " \"${arg//" << BUNDLE_VAR << "/$DIR}\")\n"
+      << "done < \"$DIR/plugin.args\"\n"
+      << "\n"
+      << "if [ -z \"${PERF+x}\" ]; then\n"
+      << "  PERF=(perf record -g -o \"$DIR/out/perf.data\" --)\n"
+      << "else\n"
+      << "  read -ra PERF <<< \"$PERF\"\n"
+      << "fi\n"
+      << "\n"
+      << "export ARG_STATES_OUT_DIR=\"${ARG_STATES_OUT_DIR:-$DIR/out}\"\n"
+      << "if [ -n \"${" << METRICS_FILE_ENV << "+x}\" ]; then\n"
+      << "  export " << METRICS_FILE_ENV << "=\"$DIR/out/metrics.ndjson\"\n"
+      << "fi\n"
+      << "\"${PERF[@]}\" \"${CLANG:-clang}\" -cc1 \"${CC1[@]}\" \\\n"
+      << "  -ivfsoverlay \"$DIR/overlay.yaml\" \\\n"
+      << "  -load \"${PLUGIN:-" << this->pluginPath << "}\" \\\n"
+      << "  -plugin " << this->plugin << " \"${PLUGIN_ARGS[@]}\" \\\n"
+      << "  > \"$DIR/out/stdout\"\n";
+    return s.str();
+  }
+}
@@ -0,0 +1,149 @@
+#include "Schedule.hpp"
+
+#include "llvm/ADT/StringMap.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace schedule {
+  //---------------------------------------------------------------------------
+  // Clustering
+  //---------------------------------------------------------------------------
+  using FileSet = std::vector<uint32_t>;
+
+  /// |a ∩ b| / |a ∪ b| of two sorted sets
+  static double getSimilarity(const FileSet &a, const FileSet &b) {
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+      if (a[i] == b[j]) {
+        common++;
+        i++;
+        j++;
+      } else if (a[i] < b[j]) {
+        i++;
+      } else {
+        j++;
+      }
+    }
+    const size_t total = a.size() + b.size() - common;
+    return total == 0 ? 0 : (double)common / total;
+  }
+
+  std::vector<std::vector<size_t>> clusterByDependencies(
+      const std::vector<std::vector<std::string>> &dependencies,
+      double threshold) {
+    // Paths are compared as IDs
+    llvm::StringMap<uint32_t> ids;
+    std::vector<FileSet> sets(dependencies.size());
+    for (size_t i = 0; i < dependencies.size(); i++) {
+      for (const auto &file : dependencies[i]) {
+        sets[i].push_back(ids.try_emplace(file, ids.size()).first->second);
+      }
+      std::sort(sets[i].begin(), sets[i].end());
+      sets[i].erase(std::unique(sets[i].begin(), sets[i].end()),
+                    sets[i].end());
+    }
+
+    std::vector<size_t> order(dependencies.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return sets[lhs].size() > sets[rhs].size();
+    });
+
+    std::vector<std::vector<size_t>> clusters;
+    // The first TU of every cluster
+    std::vector<size_t> leaders;
+    for (const auto tu : order) {
+      size_t best = clusters.size();
+      double bestSimilarity = threshold;
+      if (!sets[tu].empty()) {
+        for (size_t c = 0; c < clusters.size(); c++) {
+          const double similarity = getSimilarity(sets[tu], sets[leaders[c]]);
+          if (similarity >= bestSimilarity) {
+            best = c;
+            bestSimilarity = similarity;
+          }
+        }
+      }
+      if (best == clusters.size()) {
+        clusters.push_back({});
+        leaders.push_back(tu);
+      }
+      clusters[best].push_back(tu);
+    }
+    return clusters;
+  }
+
+  //---------------------------------------------------------------------------
+  // WorkQueues
+  //---------------------------------------------------------------------------
+  WorkQueues::WorkQueues(const std::vector<std::vector<size_t>> &clusters,
+      const std::vector<size_t> &costs, unsigned workers)
+    : queues(std::max(workers, 1U)) {
+    std::vector<size_t> clusterCosts(clusters.size(), 0);
+    for (size_t c = 0; c < clusters.size(); c++) {
+      for (const auto tu : clusters[c]) {
+        clusterCosts[c] += costs[tu];
+      }
+    }
+    std::vector<size_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+      return clusterCosts[lhs] > clusterCosts[rhs];
+    });
+
+    std::vector<size_t> loads(this->queues.size(), 0);
+    for (const auto c : order) {
+      const size_t worker = std::min_element(loads.begin(), loads.end()) -
+                            loads.begin();
+      loads[worker] += clusterCosts[c];
+      this->queues[worker].insert(this->queues[worker].end(),
+          clusters[c].begin(), clusters[c].end());
+    }
+  }
+
+  std::optional<size_t> WorkQueues::next(unsigned worker) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto &own = this->queues[worker % this->queues.size()];
+    if (!own.empty()) {
+      const auto tu = own.front();
+      own.pop_front();
+      return tu;
+    }
+
+    auto victim = std::max_element(this->queues.begin(), this->queues.end(),
+        [](const std::deque<size_t> &lhs, const std::deque<size_t> &rhs) {
+          return lhs.size() < rhs.size();
+        });
+    if (victim->empty()) {
+      return std::nullopt;
+    }
+    const auto tu = victim->back();
+    victim->pop_back();
+    this->steals++;
+    return tu;
+  }
+
+  std::vector<size_t> WorkQueues::getExpectedOrder() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<size_t> order;
+    for (size_t k = 0;; k++) {
+      bool any = false;
+      for (const auto &queue : this->queues) {
+        if (k < queue.size()) {
+          order.push_back(queue[k]);
+          any = true;
+        }
+      }
+      if (!any) {
+        return order;
+      }
+    }
+  }
+
+  size_t WorkQueues::getSteals() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->steals;
+  }
+}
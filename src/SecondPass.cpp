@@ -7,6 +7,7 @@
 // (Unfinished)
 //-----------------------------------------------------------------------------
 void SecondPassASTConsumer::HandleTranslationUnit(ASTContext &ctx) {
+  llvm::TimeTraceScope timeScope("ArgStates second pass");
   this->finder.matchAST(ctx);
 }
 
@@ -62,7 +63,7 @@ run(const MatchFinder::MatchResult &result) {
 
     if (declRef) {
       const auto name = declRef->getDecl()->getName();
-      util::dumpMatch("REF", name, 2, srcMgr, declRef->getEndLoc());
+      util::dumpMatch("REF", name, 2, declRef->getEndLoc());
     }
 }
 
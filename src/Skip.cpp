@@ -0,0 +1,137 @@
+#include "Skip.hpp"
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+
+using namespace clang;
+
+namespace skip {
+  bool enable(CompilerInstance &CI, llvm::StringRef plugin,
+      std::string &reason) {
+    auto &opts = CI.getFrontendOpts();
+    if (opts.ProgramAction != frontend::PluginAction ||
+        opts.ActionName != plugin) {
+      reason = "the bodies are needed by the main action, run the plugin "
+               "with -plugin rather than -add-plugin";
+      return false;
+    }
+    // Read by ASTFrontendAction::ExecuteAction() after the consumer has
+    // been created
+    opts.SkipFunctionBodies = true;
+    return true;
+  }
+
+  BodyFilter::BodyFilter(Preprocessor &pp,
+      const std::vector<std::string> &names) : pp(pp) {
+    for (const auto &name : names) {
+      this->names.insert(name);
+    }
+  }
+
+  bool BodyFilter::shouldSkip(const Decl* decl) {
+    const auto fn = decl->getAsFunction();
+    if (fn != nullptr && this->canSkip(fn)) {
+      this->skipped++;
+      return true;
+    }
+    this->parsed++;
+    return false;
+  }
+
+  bool BodyFilter::isNameMacro(llvm::StringRef name) const {
+    const auto &identifiers = this->pp.getIdentifierTable();
+    const auto it = identifiers.find(name);
+    if (it == identifiers.end()) {
+      return false;
+    }
+    llvm::SmallPtrSet<const IdentifierInfo*, 8> visited;
+    return this->canExpandToName(it->getValue(), visited);
+  }
+
+  /// Follows the replacement tokens of the current definition of 'macro'
+  /// through the nested macros, each macro is only visited once
+  bool BodyFilter::canExpandToName(const IdentifierInfo* macro,
+      llvm::SmallPtrSetImpl<const IdentifierInfo*> &visited) const {
+    if (!macro->hasMacroDefinition() || !visited.insert(macro).second) {
+      return false;
+    }
+    const auto info = this->pp.getMacroInfo(macro);
+    if (info == nullptr) {
+      return false;
+    }
+    for (const auto &tok : info->tokens()) {
+      // Any identifier could be pasted together
+      if (tok.is(tok::hashhash)) {
+        return true;
+      }
+      const auto ii = tok.getIdentifierInfo();
+      if (ii != nullptr && (this->names.count(ii->getName()) ||
+                            this->canExpandToName(ii, visited))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Scan from the end of the declarator (the body has not been parsed yet)
+  /// to the brace that closes the body
+  bool BodyFilter::canSkip(const FunctionDecl* fn) const {
+    const auto start = fn->getEndLoc();
+    if (start.isInvalid() || start.isMacroID() ||
+        isa<CXXConstructorDecl>(fn)) {
+      return false;
+    }
+    const auto &srcMgr = this->pp.getSourceManager();
+    const auto [fileID, offset] = srcMgr.getDecomposedLoc(start);
+    bool invalid = false;
+    const auto buffer = srcMgr.getBufferData(fileID, &invalid);
+    if (invalid) {
+      return false;
+    }
+
+    Lexer lexer(srcMgr.getLocForStartOfFile(fileID), this->pp.getLangOpts(),
+                buffer.begin(), buffer.begin() + offset, buffer.end());
+    Token tok;
+    unsigned depth = 0;
+
+    while (true) {
+      lexer.LexFromRawLexer(tok);
+      switch (tok.getKind()) {
+        case tok::eof:
+        case tok::hash:
+          return false;
+        case tok::colon:
+          // A constructor initializer list (only in front of the body,
+          // labels and the conditional operator are fine)
+          if (depth == 0) {
+            return false;
+          }
+          break;
+        case tok::l_brace:
+          depth++;
+          break;
+        case tok::r_brace:
+          if (depth == 0) {
+            return false;
+          }
+          if (--depth == 0) {
+            return true;
+          }
+          break;
+        case tok::raw_identifier: {
+          const auto name = tok.getRawIdentifier();
+          if (depth == 0 && name == "try") {
+            return false;
+          }
+          if (this->names.count(name) || this->isNameMacro(name)) {
+            return false;
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+}
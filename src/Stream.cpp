@@ -0,0 +1,66 @@
+#include "Stream.hpp"
+
+#include "clang/AST/DeclCXX.h"
+
+using namespace clang;
+
+namespace stream {
+  bool hasTemplates(const Decl* decl) {
+    if (decl->isTemplated()) {
+      return true;
+    }
+    const auto* ctx = dyn_cast<DeclContext>(decl);
+    if (ctx && (isa<NamespaceDecl>(decl) || isa<LinkageSpecDecl>(decl) ||
+                isa<CXXRecordDecl>(decl))) {
+      return llvm::any_of(ctx->decls(), hasTemplates);
+    }
+    return false;
+  }
+
+  std::vector<Decl*> DeclTracker::inlineDefinition(FunctionDecl* decl) {
+    this->matched.insert(decl);
+
+    for (auto* ctx = decl->getLexicalDeclContext();
+         ctx != nullptr && !ctx->isTranslationUnit();
+         ctx = ctx->getLexicalParent()) {
+      if (!this->containers.insert(ctx).second) {
+        break;
+      }
+    }
+    return {decl};
+  }
+
+  std::vector<Decl*> DeclTracker::topLevelDecls(DeclGroupRef group) {
+    std::vector<Decl*> scope;
+
+    for (auto* decl : group) {
+      this->collect(decl, scope);
+    }
+
+    // Every inline definition seen so far was part of this group
+    this->matched.clear();
+    this->containers.clear();
+    return scope;
+  }
+
+  void DeclTracker::collect(Decl* decl, std::vector<Decl*> &scope) {
+    if (this->matched.count(decl)) {
+      return;
+    }
+
+    // Only namespaces, linkage specifications and classes are split up,
+    // anything else (e.g. a function with a local class) is matched whole
+    const auto* ctx = dyn_cast<DeclContext>(decl);
+    const bool canSplit = isa<NamespaceDecl>(decl) ||
+                          isa<LinkageSpecDecl>(decl) ||
+                          isa<CXXRecordDecl>(decl);
+
+    if (ctx && canSplit && this->containers.count(ctx)) {
+      for (auto* child : ctx->decls()) {
+        this->collect(child, scope);
+      }
+    } else {
+      scope.push_back(decl);
+    }
+  }
+}
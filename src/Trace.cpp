@@ -0,0 +1,30 @@
+#include "Trace.hpp"
+#include "Log.hpp"
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace trace {
+  // Spans shorter than this (in microseconds) are left out, the
+  // same default as for clang's -ftime-trace-granularity
+  static constexpr unsigned GRANULARITY = 500;
+
+  Session::Session(std::string path, llvm::StringRef procName)
+    : path(std::move(path)) {
+    if (llvm::getTimeTraceProfilerInstance() == nullptr) {
+      llvm::timeTraceProfilerInitialize(GRANULARITY, procName);
+      this->ownsProfiler = true;
+    }
+  }
+
+  Session::~Session() {
+    if (!this->ownsProfiler) {
+      return;
+    }
+    if (auto err = llvm::timeTraceProfilerWrite(this->path, this->path)) {
+      PRINT_ERR("Failed to write time trace: "
+                << llvm::toString(std::move(err)));
+    }
+    llvm::timeTraceProfilerCleanup();
+  }
+}
@@ -1,35 +1,76 @@
 #include "ArgStates.hpp"
 
-static void addComma(std::ofstream &f, uint iter, uint size, 
+static void addComma(std::ostream &f, uint iter, uint size, 
   bool newline=false){
     if (iter != size) {
       f << ", ";
     }
     newline && f << "\n";
 }
-static void writeStates(const struct ArgState& argState, std::ofstream &f) {
-      uint stateSize = argState.states.size();
-      uint k = 0;
-      for (const auto &item : argState.states) {
-        // Write the correct type
-        switch(argState.type){
-          case INT:
-            f << std::get<uint64_t>(item);
-            break;
-          case CHR:
-            f << std::get<unsigned int>(item);
-            break;
-          case STR:
-            f << "\"" << std::get<std::string>(item) << "\"";
-            break;
-          case UNARY:
-            f << std::get<uint64_t>(item);
-            break;
-          default:
-            PRINT_ERR("ArgState with 'NONE' type encountered");
+
+void writeStates(const struct ArgState& argState, std::ostream &f,
+  bool intRanges, const StringPool &pool) {
+      // Values are separated by a comma, the separator is written
+      // before every value except the first
+      bool first = true;
+      auto separate = [&]() {
+        if (!first) {
+          f << ", ";
+        }
+        first = false;
+      };
+
+      // Write the correct type
+      switch(argState.type){
+        case INT:
+        case UNARY: {
+          // Joined intervals (see IntDomain::limit()) contain values that
+          // were never observed and can span the entire value range, these
+          // are always written as ranges
+          const bool asRanges = intRanges || !argState.intStates.isExact();
+          for (const auto &interval : argState.intStates.getIntervals()) {
+            if (asRanges && interval.first != interval.last) {
+              // Range syntax: [first, last] (inclusive)
+              separate();
+              f << "[" << interval.first << ", " << interval.last << "]";
+            } else {
+              for (uint64_t v = interval.first;; v++) {
+                separate();
+                f << v;
+                if (v == interval.last) {
+                  break;
+                }
+              }
+            }
+          }
+          break;
         }
-        k++;
-        addComma(f,k,stateSize);
+        case CHR:
+          argState.chrStates.forEach([&](unsigned value) {
+            separate();
+            f << value;
+          });
+          break;
+        case STR: {
+          // The IDs follow the order in which strings were first seen,
+          // the output is sorted by value
+          std::vector<StringRef> values;
+          values.reserve(argState.strStates.size());
+          for (const auto id : argState.strStates) {
+            values.push_back(pool.get(id));
+          }
+          std::sort(values.begin(), values.end());
+
+          for (const auto &item : values) {
+            separate();
+            f << "\"";
+            f.write(item.data(), item.size());
+            f << "\"";
+          }
+          break;
+        }
+        default:
+          PRINT_ERR("ArgState with 'NONE' type encountered");
       }
 }
 
@@ -39,6 +80,7 @@ void ArgStatesASTConsumer::dumpArgStates(){
   if (this->argumentStates.size() == 0){
     return;
   }
+  llvm::TimeTraceScope timeScope("ArgStates output", this->filename);
   auto filename = this->getOutputPath();
 
   if(filename.size()==0) { 
@@ -50,43 +92,62 @@ void ArgStatesASTConsumer::dumpArgStates(){
 
   std::ofstream f;
   f.open(filename, std::ofstream::out|std::ofstream::trunc);
+  writeArgStates(f, this->symbolName, this->argumentStates, this->options,
+      this->pool);
+  f.close();
+}
 
+void writeArgStates(std::ostream &f, const std::string &symbolName,
+  const std::vector<ArgState> &argumentStates,
+  const ArgStatesOptions &options, const StringPool &pool) {
   f << "{\n"
     << INDENT << "\"" << symbolName << "\": {\n";
 
 
-  std::string paramName;
-  ArgState argState;
-  uint argCnt = this->argumentStates.size();
-  for (uint i = 0; i < this->argumentStates.size(); i++) {
-    argState = this->argumentStates[i]; 
+  // Unless all parameters were analyzed, the entries for the parameters
+  // that were not selected are only placeholders
+  std::vector<uint> indices;
+  for (uint i = 0; i < argumentStates.size(); i++) {
+    if (options.params.empty() ||
+        options.params.contains(argumentStates[i].paramName, i)) {
+      indices.push_back(i);
+    }
+  }
+
+  uint argCnt = indices.size();
+  for (uint n = 0; n < indices.size(); n++) {
+    const uint i = indices[n];
+    const auto &argState = argumentStates[i];
+
+    f << INDENT << INDENT << "\"";
 
     // Fallback to parameter index for unnamed entries
-    paramName = argState.paramName.size()==0 ? 
-                std::to_string(i) :
-                paramName = argState.paramName;
+    if (argState.paramName.size()==0) {
+      f << i;
+    } else {
+      f << argState.paramName;
+    }
 
-    f << INDENT << INDENT << "\"" << paramName << "\": [";
+    f << "\": [";
 
     // nondet() arguments will have been given an empty list of states
     // det() arguments need to have an empty ids[] set, otherwise an invocation
     // matched by ANY still exists that is nondet() for the argument
-    if (!argState.isNonDet && argState.ids.size() == 0){
+    if (!argState.isNonDet && argState.getIdCount() == 0){
       f << "\n" << INDENT << INDENT << INDENT;
 
       // Only one of the state sets will contain values for an argument
-      writeStates(argState, f);
+      writeStates(argState, f, options.intRanges, pool);
       f << "\n" << INDENT << INDENT;
     }
 
     f << "]";
     
-    addComma(f,i+1,argCnt,true);
+    addComma(f,n+1,argCnt,true);
   }
 
   f << INDENT << "}\n"
     << "}\n";
-  f.close();
 }
 
 std::string ArgStatesASTConsumer::getOutputPath(){
@@ -0,0 +1,39 @@
+#include "Analysis.hpp"
+
+#include "clang/Tooling/Tooling.h"
+
+#include <gtest/gtest.h>
+
+//-----------------------------------------------------------------------------
+// Renames (analysis::computeRenames())
+// Only the main file is edited, as by the plugin. A declaration in a header
+// must not keep the renames of the main file from being returned.
+//-----------------------------------------------------------------------------
+TEST(Renames, OnlyTheMainFile) {
+  const std::string code =
+    "#include \"rename.h\"\n"
+    "int target(int n) { return n + counter; }\n"
+    "int f(void) { return target(1); }\n";
+  const auto unit = clang::tooling::buildASTFromCodeWithArgs(code, {"-xc"},
+      "/rename/rename.c", "clang-tool",
+      std::make_shared<clang::PCHContainerOperations>(),
+      clang::tooling::getClangStripDependencyFileAdjuster(),
+      {{"/rename/rename.h", "int target(int n);\nextern int counter;\n"}});
+  ASSERT_TRUE(unit);
+  ASSERT_FALSE(unit->getDiagnostics().hasErrorOccurred());
+
+  const auto replacements = analysis::computeRenames(unit->getASTContext(),
+      {"target", "counter"}, "_old");
+  ASSERT_EQ(replacements.size(), 3U);
+  for (const auto &replacement : replacements) {
+    EXPECT_EQ(replacement.getFilePath(), "/rename/rename.c");
+  }
+
+  const auto renamed = clang::tooling::applyAllReplacements(code,
+      replacements);
+  ASSERT_TRUE(static_cast<bool>(renamed));
+  EXPECT_EQ(*renamed,
+    "#include \"rename.h\"\n"
+    "int target_old(int n) { return n + counter_old; }\n"
+    "int f(void) { return target_old(1); }\n");
+}
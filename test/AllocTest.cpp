@@ -0,0 +1,41 @@
+#include "ArgStates.hpp"
+
+#include <gtest/gtest.h>
+
+#include "MatchRecorder.hpp"
+#include "TestUtil.hpp"
+
+//-----------------------------------------------------------------------------
+// The matches of a TU are recorded once and handled twice by the same
+// FirstPassMatcher. The second time, every call site and every value has
+// already been recorded (the steady state) and no match may allocate.
+//
+// The first match of a call site is not checked: the call is added to the
+// per-TU record of call sites (callSites, seenCalls and the interned keys
+// in callKeys, see FirstPassMatcher::isDuplicate()). These grow with the
+// number of call sites in the TU, i.e. they allocate amortized on new
+// call sites by design.
+//-----------------------------------------------------------------------------
+TEST(Alloc, NoAllocationsForSeenCallSites) {
+  const auto unit = test::parseInput("jobs.c");
+  ASSERT_TRUE(unit);
+  auto &ctx = unit->getASTContext();
+
+  const ArgStatesOptions options;
+  const auto matches = test::recordFirstPassMatches(ctx, "target", options);
+  ASSERT_FALSE(matches.empty());
+
+  StringPool pool;
+  FirstPassMatcher handler(options, pool);
+  for (const auto &match : matches) {
+    test::replayMatch(handler, match, ctx);
+  }
+  ASSERT_FALSE(handler.argumentStates.empty());
+
+  for (size_t i = 0; i < matches.size(); i++) {
+    const auto before = test::getAllocCount();
+    test::replayMatch(handler, matches[i], ctx);
+    EXPECT_EQ(test::getAllocCount() - before, 0U)
+      << "match " << i << " allocated";
+  }
+}
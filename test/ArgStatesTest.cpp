@@ -0,0 +1,221 @@
+#include "Analysis.hpp"
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Tooling/Tooling.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "Skip.hpp"
+#include "TestUtil.hpp"
+
+//-----------------------------------------------------------------------------
+// Duplicate call sites
+// A call is only skipped as a duplicate of an earlier call if it has the
+// same spelling and the same arguments. Macro expansions and template
+// instantiations share the spelling of their calls but not their values.
+//-----------------------------------------------------------------------------
+static void expectAllocSizes(const std::string &input,
+ const std::vector<uint64_t> &counts) {
+  const auto unit = test::parseInput(input);
+  ASSERT_TRUE(unit);
+  const ArgStatesOptions options;
+
+  const auto results = analysis::analyzeArgStates(unit->getASTContext(),
+      {"target"}, options);
+  ASSERT_EQ(results.size(), 1U);
+  const auto &states = results[0].argumentStates;
+  ASSERT_EQ(states.size(), 2U);
+
+  const std::vector<uint64_t> sizes = {
+    sizeof(char), sizeof(int), sizeof(double)
+  };
+  EXPECT_EQ(states[0].type, UNARY);
+  EXPECT_FALSE(states[0].isNonDet);
+  EXPECT_EQ(states[0].getIdCount(), 0U);
+  EXPECT_EQ(test::intValues(states[0]), sizes);
+  EXPECT_EQ(states[1].type, INT);
+  EXPECT_FALSE(states[1].isNonDet);
+  EXPECT_EQ(states[1].getIdCount(), 0U);
+  EXPECT_EQ(test::intValues(states[1]), counts);
+}
+
+TEST(Dedup, MacroExpansionsKeepTheirValues) {
+  expectAllocSizes("dedup_macro.c", {1, 2});
+}
+
+TEST(Dedup, TemplateInstantiationsKeepTheirValues) {
+  expectAllocSizes("dedup_template.cpp", {3});
+}
+
+//-----------------------------------------------------------------------------
+// Concurrent matching (-jobs)
+// Every worker matches a copy of the TU of its own, the merged results must
+// give the same output as a serial run.
+//-----------------------------------------------------------------------------
+static std::string writeResults(const analysis::ArgStatesResults &results,
+ const ArgStatesOptions &options) {
+  std::ostringstream out;
+  for (const auto &result : results) {
+    result.write(out, options);
+  }
+  return out.str();
+}
+
+TEST(Jobs, SameOutputAsSerial) {
+  const auto unit = test::parseInput("jobs.c");
+  ASSERT_TRUE(unit);
+  const std::vector<std::string> symbols = {"target"};
+
+  ArgStatesOptions options;
+  const auto serial = analysis::analyzeArgStates(unit->getASTContext(),
+      symbols, options);
+  ASSERT_FALSE(serial[0].argumentStates.empty());
+
+  for (const uint jobs : {2U, 4U, 8U}) {
+    options.jobs = jobs;
+    const auto concurrent = analysis::analyzeArgStates(unit->getASTContext(),
+        symbols, options, [] { return test::parseInput("jobs.c"); });
+    EXPECT_EQ(writeResults(concurrent, options),
+              writeResults(serial, options)) << "-jobs " << jobs;
+
+    // The copies are gone, no node of theirs may be left in the states
+    const auto &states = concurrent[0].argumentStates;
+    ASSERT_EQ(states.size(), serial[0].argumentStates.size());
+    for (size_t k = 0; k < states.size(); k++) {
+      EXPECT_TRUE(states[k].ids.empty()) << "param " << k;
+      EXPECT_EQ(states[k].getIdCount(),
+                serial[0].argumentStates[k].getIdCount()) << "param " << k;
+    }
+  }
+}
+
+TEST(Jobs, CopiesFitIntoMemoryLimit) {
+  const auto unit = test::parseInput("jobs.c");
+  ASSERT_TRUE(unit);
+  const auto &ctx = unit->getASTContext();
+  EXPECT_EQ(parallel::getMaxJobs(ctx, 0), 1U);
+  EXPECT_EQ(parallel::getMaxJobs(ctx, 8), 8U);
+}
+
+/// The number of function definitions with a body in the TU
+static size_t countBodies(clang::ASTContext &ctx) {
+  return match(functionDecl(isDefinition(), hasBody(stmt())), ctx).size();
+}
+
+// -skip-bodies sets SkipFunctionBodies on the invocation of the running
+// compiler (see Skip.hpp), the copies of the workers must still parse
+// every body
+TEST(Jobs, SkipBodiesInvocation) {
+  const auto invocation = test::createInvocation("jobs.c");
+  ASSERT_TRUE(invocation);
+  const auto unit = test::parseInvocation(*invocation);
+  ASSERT_TRUE(unit);
+  const std::vector<std::string> symbols = {"target"};
+  auto &ctx = unit->getASTContext();
+
+  ArgStatesOptions options;
+  const auto serial = analysis::analyzeArgStates(ctx, symbols, options);
+  ASSERT_FALSE(serial[0].argumentStates.empty());
+
+  auto skipBodies = *invocation;
+  skipBodies.getFrontendOpts().SkipFunctionBodies = true;
+  const auto factory = parallel::reparseFrom(skipBodies,
+      unit->getSourceManager());
+  const auto copy = factory();
+  ASSERT_TRUE(copy);
+  EXPECT_EQ(countBodies(copy->getASTContext()), countBodies(ctx));
+
+  for (const uint jobs : {2U, 4U, 8U}) {
+    options.jobs = jobs;
+    const auto concurrent = analysis::analyzeArgStates(ctx, symbols, options,
+        factory);
+    EXPECT_EQ(writeResults(concurrent, options),
+              writeResults(serial, options)) << "-jobs " << jobs;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Parameter selection (-params)
+//-----------------------------------------------------------------------------
+TEST(Params, UnmatchedEntries) {
+  const auto unit = clang::tooling::buildASTFromCodeWithArgs(
+      "int target(int n, const char* s);\n"
+      "int target(int, const char*);\n", {"-xc"}, "params.c");
+  ASSERT_TRUE(unit);
+  const auto* decl = selectFirst<FunctionDecl>("DECL",
+      match(functionDecl(hasName("target")).bind("DECL"),
+        unit->getASTContext()));
+  ASSERT_TRUE(decl);
+
+  ParamSelection params;
+  ASSERT_TRUE(params.parse("n,size,1,2"));
+  // The names are taken from the first declaration
+  const std::vector<std::string> unmatched = {"size", "2"};
+  EXPECT_EQ(params.getUnmatched(decl->getMostRecentDecl()), unmatched);
+}
+
+//-----------------------------------------------------------------------------
+// Function body skipping (-skip-bodies)
+// A macro in a body only keeps it if the macro can expand to one of the
+// names, through its replacement tokens or those of the nested macros.
+//-----------------------------------------------------------------------------
+namespace {
+  /// Records the names of the functions whose bodies the filter skips
+  class SkipConsumer : public ASTConsumer {
+  public:
+    SkipConsumer(Preprocessor &pp, std::vector<std::string> &skipped)
+      : filter(pp, {"target"}), skipped(skipped) {}
+
+    bool shouldSkipFunctionBody(Decl *decl) override {
+      if (!this->filter.shouldSkip(decl)) {
+        return false;
+      }
+      this->skipped.push_back(cast<NamedDecl>(decl)->getNameAsString());
+      return true;
+    }
+
+  private:
+    skip::BodyFilter filter;
+    std::vector<std::string> &skipped;
+  };
+
+  class SkipAction : public ASTFrontendAction {
+  public:
+    explicit SkipAction(std::vector<std::string> &skipped)
+      : skipped(skipped) {}
+
+  protected:
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+        llvm::StringRef) override {
+      // Read after the consumer has been created, as with skip::enable()
+      CI.getFrontendOpts().SkipFunctionBodies = true;
+      return std::make_unique<SkipConsumer>(CI.getPreprocessor(),
+          this->skipped);
+    }
+
+  private:
+    std::vector<std::string> &skipped;
+  };
+}
+
+TEST(SkipBodies, MacroExpansions) {
+  const std::string code =
+    "#define NULL ((void*)0)\n"
+    "#define CALL target\n"
+    "#define INDIRECT CALL\n"
+    "#define PASTE(a, b) a ## b\n"
+    "int target(void* p);\n"
+    "int null(void) { return NULL == 0; }\n"
+    "int call(void) { return CALL(NULL); }\n"
+    "int indirect(void) { return INDIRECT(0); }\n"
+    "int paste(void) { return PASTE(tar, get)(0); }\n"
+    "int direct(void) { return target(NULL); }\n";
+  std::vector<std::string> skipped;
+  ASSERT_TRUE(clang::tooling::runToolOnCodeWithArgs(
+        std::make_unique<SkipAction>(skipped), code, {"-xc"}, "skip.c"));
+
+  const std::vector<std::string> expected = {"null"};
+  EXPECT_EQ(skipped, expected);
+}
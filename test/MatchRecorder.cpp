@@ -0,0 +1,213 @@
+#include "MatchRecorder.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// The only replacement of the global operator new and of malloc() in the
+// executable, every variant counts as one allocation on the calling thread
+static thread_local uint64_t AllocCount = 0;
+
+#ifdef __GLIBC__
+// The glibc allocator under its internal names, the replacements below
+// forward to these so that an operator new is not counted twice
+extern "C" {
+  void* __libc_malloc(std::size_t size);
+  void* __libc_calloc(std::size_t count, std::size_t size);
+  void* __libc_realloc(void* ptr, std::size_t size);
+  void* __libc_memalign(std::size_t alignment, std::size_t size);
+  void  __libc_free(void* ptr);
+
+  // LLVM allocates e.g. the SmallVector buffers with malloc() (see
+  // llvm::safe_malloc()), which never passes through operator new
+  void* malloc(std::size_t size) {
+    AllocCount++;
+    return __libc_malloc(size);
+  }
+
+  void* calloc(std::size_t count, std::size_t size) {
+    AllocCount++;
+    return __libc_calloc(count, size);
+  }
+
+  void* realloc(void* ptr, std::size_t size) {
+    AllocCount++;
+    return __libc_realloc(ptr, size);
+  }
+
+  void free(void* ptr) {
+    __libc_free(ptr);
+  }
+}
+
+static void* allocate(std::size_t size) {
+  return __libc_malloc(size);
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+  return __libc_memalign(static_cast<std::size_t>(alignment), size);
+}
+
+static void deallocate(void* ptr) {
+  __libc_free(ptr);
+}
+#else
+static void* allocate(std::size_t size) {
+  return std::malloc(size);
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment) {
+  void* ptr = nullptr;
+  return posix_memalign(&ptr, static_cast<std::size_t>(alignment), size) == 0 ?
+    ptr : nullptr;
+}
+
+static void deallocate(void* ptr) {
+  std::free(ptr);
+}
+#endif
+
+static void* countedNew(std::size_t size) noexcept {
+  AllocCount++;
+  return allocate(size == 0 ? 1 : size);
+}
+
+static void* countedNew(std::size_t size, std::align_val_t alignment)
+ noexcept {
+  AllocCount++;
+  return allocateAligned(size == 0 ? 1 : size, alignment);
+}
+
+void* operator new(std::size_t size) {
+  if (void* ptr = countedNew(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedNew(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedNew(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  if (void* ptr = countedNew(size, alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment,
+ const std::nothrow_t&) noexcept {
+  return countedNew(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment,
+ const std::nothrow_t&) noexcept {
+  return countedNew(size, alignment);
+}
+
+// Every variant was allocated by the same allocator, the size and
+// alignment of a delete are not needed
+void operator delete(void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t,
+ const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t,
+ const std::nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+namespace test {
+  namespace {
+    using Handler = FirstPassCallback::Handler;
+
+    /// Records the bound nodes of every match for the handler of a matcher
+    class RecordingCallback : public MatchFinder::MatchCallback {
+    public:
+      RecordingCallback(std::vector<RecordedMatch> &matches, Handler handler)
+        : matches(matches), handler(handler) {}
+
+      void run(const MatchFinder::MatchResult &result) override {
+        this->matches.push_back({this->handler, result.Nodes});
+      }
+
+    private:
+      std::vector<RecordedMatch> &matches;
+      Handler handler;
+    };
+  }
+
+  uint64_t getAllocCount() {
+    return AllocCount;
+  }
+
+  std::vector<RecordedMatch> recordFirstPassMatches(ASTContext &ctx,
+      const std::string &symbolName, const ArgStatesOptions &options) {
+    std::vector<RecordedMatch> matches;
+    RecordingCallback any(matches, &FirstPassMatcher::handleAnyMatch);
+    RecordingCallback ref(matches, &FirstPassMatcher::handleRefMatch);
+    RecordingCallback intLiteral(matches, &FirstPassMatcher::handleIntMatch);
+    RecordingCallback strLiteral(matches, &FirstPassMatcher::handleStrMatch);
+    RecordingCallback chrLiteral(matches, &FirstPassMatcher::handleChrMatch);
+    RecordingCallback unary(matches, &FirstPassMatcher::handleUnaryMatch);
+
+    MatchFinder finder;
+    FirstPassASTConsumer::addMatchers(finder, symbolName, options,
+        /*matchDecls=*/false,
+        {&any, &ref, &intLiteral, &strLiteral, &chrLiteral, &unary});
+    finder.matchAST(ctx);
+    return matches;
+  }
+}
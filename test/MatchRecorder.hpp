@@ -0,0 +1,40 @@
+#ifndef Test_MatchRecorder_H
+#define Test_MatchRecorder_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ArgStates.hpp"
+
+//-----------------------------------------------------------------------------
+// Recorded first pass matches and heap allocation counts
+// Shared by test/AllocTest.cpp and bench/BenchMatch.cpp. Every executable
+// that compiles MatchRecorder.cpp counts the allocations made through every
+// variant of its global operator new and (with glibc) through malloc(),
+// calloc() and realloc(). The counter is read before and after the code
+// that is checked.
+//-----------------------------------------------------------------------------
+namespace test {
+  struct RecordedMatch {
+    FirstPassCallback::Handler handler;
+    BoundNodes nodes;
+  };
+
+  /// Allocations made on the calling thread so far
+  uint64_t getAllocCount();
+
+  /// The bound nodes of every first pass match for 'symbolName' in the TU,
+  /// in match order, together with the handler of the matcher
+  std::vector<RecordedMatch> recordFirstPassMatches(ASTContext &ctx,
+      const std::string &symbolName, const ArgStatesOptions &options);
+
+  /// Hand a recorded match to its handler in 'matcher'
+  inline void replayMatch(FirstPassMatcher &matcher,
+      const RecordedMatch &match, ASTContext &ctx) {
+    const MatchFinder::MatchResult result(match.nodes, &ctx);
+    (matcher.*match.handler)(result);
+  }
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "TestUtil.hpp"
+
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/Utils.h"
+#include "clang/Serialization/PCHContainerOperations.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <gtest/gtest.h>
+
+namespace test {
+  std::unique_ptr<clang::ASTUnit> parseInput(const std::string &name) {
+    const auto path = std::string(TEST_INPUT_DIR) + "/" + name;
+    const auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer) {
+      ADD_FAILURE() << "Failed to read " << path;
+      return nullptr;
+    }
+    const std::vector<std::string> args = llvm::StringRef(name).endswith(".c") ?
+      std::vector<std::string>{"-xc", "-Werror"} :
+      std::vector<std::string>{"-xc++", "-std=c++17", "-Werror"};
+
+    auto unit = clang::tooling::buildASTFromCodeWithArgs(
+        (*buffer)->getBuffer(), args, name);
+    if (!unit || unit->getDiagnostics().hasErrorOccurred()) {
+      ADD_FAILURE() << "Failed to compile " << path;
+      return nullptr;
+    }
+    return unit;
+  }
+
+  std::shared_ptr<clang::CompilerInvocation> createInvocation(
+      const std::string &name) {
+    const auto path = std::string(TEST_INPUT_DIR) + "/" + name;
+    const char* lang = llvm::StringRef(name).endswith(".c") ? "c" : "c++";
+    const char* args[] = {"clang", "-fsyntax-only", "-Werror", "-x", lang,
+                          path.c_str()};
+
+    auto invocation = clang::createInvocationFromCommandLine(args,
+        clang::CompilerInstance::createDiagnostics(
+          new clang::DiagnosticOptions));
+    if (!invocation) {
+      ADD_FAILURE() << "Failed to create an invocation for " << path;
+    }
+    return invocation;
+  }
+
+  std::unique_ptr<clang::ASTUnit> parseInvocation(
+      const clang::CompilerInvocation &invocation) {
+    auto fileMgr = llvm::makeIntrusiveRefCnt<clang::FileManager>(
+        invocation.getFileSystemOpts(), llvm::vfs::getRealFileSystem());
+    auto unit = clang::ASTUnit::LoadFromCompilerInvocation(
+        std::make_shared<clang::CompilerInvocation>(invocation),
+        std::make_shared<clang::PCHContainerOperations>(),
+        clang::CompilerInstance::createDiagnostics(
+          new clang::DiagnosticOptions),
+        fileMgr.get());
+    if (!unit || unit->getDiagnostics().hasErrorOccurred()) {
+      ADD_FAILURE() << "Failed to compile the input of the invocation";
+      return nullptr;
+    }
+    return unit;
+  }
+
+  std::vector<uint64_t> intValues(const ArgState &state) {
+    std::vector<uint64_t> values;
+    for (const auto &interval : state.intStates.getIntervals()) {
+      if (interval.last - interval.first > 64U) {
+        ADD_FAILURE() << "Too many values in [" << interval.first << ", "
+                      << interval.last << "]";
+        continue;
+      }
+      // Ends on the last value, the interval may end at UINT64_MAX
+      for (auto value = interval.first;; value++) {
+        values.push_back(value);
+        if (value == interval.last) {
+          break;
+        }
+      }
+    }
+    return values;
+  }
+}
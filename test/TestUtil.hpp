@@ -0,0 +1,39 @@
+#ifndef Test_Util_H
+#define Test_Util_H
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInvocation.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Base.hpp"
+
+//-----------------------------------------------------------------------------
+// Inputs for the tests
+// The inputs are read from test/inputs, the language is taken from the
+// extension of the file name ('.c' or '.cpp').
+//-----------------------------------------------------------------------------
+namespace test {
+  /// Parse test/inputs/<name>, fails the current test if the file cannot
+  /// be read or does not compile
+  std::unique_ptr<clang::ASTUnit> parseInput(const std::string &name);
+
+  /// The invocation of a compiler run on test/inputs/<name>, as the
+  /// plugins see it in CompilerInstance::getInvocation()
+  std::shared_ptr<clang::CompilerInvocation> createInvocation(
+      const std::string &name);
+
+  /// Parse the input of 'invocation' from disk, fails the current test if
+  /// it does not compile
+  std::unique_ptr<clang::ASTUnit> parseInvocation(
+      const clang::CompilerInvocation &invocation);
+
+  /// Every value of the INT (or UNARY) states of a parameter in ascending
+  /// order, the states must not contain more than a few values
+  std::vector<uint64_t> intValues(const ArgState &state);
+}
+
+#endif
@@ -0,0 +1,15 @@
+// Every expansion of a macro shares the spelling of its arguments in the
+// macro definition, the calls still pass different values
+unsigned long target(unsigned long size, int n);
+
+#define ALLOC(T, n) target(sizeof(T), n)
+
+unsigned long allocate(void) {
+  unsigned long total = 0;
+  total += ALLOC(char, 1);
+  total += ALLOC(int, 2);
+  total += ALLOC(double, 2);
+  // Same arguments as an earlier expansion (a duplicate)
+  total += ALLOC(int, 2);
+  return total;
+}
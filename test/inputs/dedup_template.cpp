@@ -0,0 +1,13 @@
+// Every instantiation of a template shares the spelling of the call in the
+// pattern, sizeof(T) differs between them
+unsigned long target(unsigned long size, int n);
+
+template <typename T>
+unsigned long allocate() {
+  return target(sizeof(T), 3);
+}
+
+unsigned long allocateAll() {
+  return allocate<char>() + allocate<int>() + allocate<double>() +
+         allocate<int>();
+}
@@ -0,0 +1,197 @@
+// Enough top-level declarations for several chunks per thread with -jobs,
+// the calls pass different values in every function
+int target(int n, const char* s, char c, unsigned long size);
+
+#define CALL(n, s) target(n, s, 'm', sizeof(long))
+
+int f0(int x) {
+  return target(0, "alpha", 'a', sizeof(char));
+}
+
+int f1(int x) {
+  return target(1, "beta", 'b', sizeof(short));
+}
+
+int f2(int x) {
+  return target(2, "gamma", 'c', sizeof(int));
+}
+
+int f3(int x) {
+  return CALL(3, "delta");
+}
+
+int f4(int x) {
+  return target(4, "epsilon", 'e', sizeof(double));
+}
+
+int f5(int x) {
+  return target(x, "gamma", 'f', sizeof(x));
+}
+
+int f6(int x) {
+  return target(6, "beta", 'g', sizeof(short));
+}
+
+int f7(int x) {
+  return target(7, "gamma", 'h', sizeof(int));
+}
+
+int f8(int x) {
+  return target(8, "delta", 'i', sizeof(long));
+}
+
+int f9(int x) {
+  return target(9, "epsilon", 'j', sizeof(double));
+}
+
+int f10(int x) {
+  return CALL(10, "alpha");
+}
+
+int f11(int x) {
+  return target(11, "beta", 'l', sizeof(short));
+}
+
+int f12(int x) {
+  return target(12, "gamma", 'm', sizeof(int));
+}
+
+int f13(int x) {
+  return target(13, "delta", 'n', sizeof(long));
+}
+
+int f14(int x) {
+  return target(14, "epsilon", 'o', sizeof(double));
+}
+
+int f15(int x) {
+  return target(15, "alpha", 'p', sizeof(char));
+}
+
+int f16(int x) {
+  return target(16, "beta", 'q', sizeof(short));
+}
+
+int f17(int x) {
+  return CALL(6, "gamma");
+}
+
+int f18(int x) {
+  return target(x, "alpha", 's', sizeof(x));
+}
+
+int f19(int x) {
+  return target(2, "epsilon", 't', sizeof(double));
+}
+
+int f20(int x) {
+  return target(3, "alpha", 'u', sizeof(char));
+}
+
+int f21(int x) {
+  return target(4, "beta", 'v', sizeof(short));
+}
+
+int f22(int x) {
+  return target(5, "gamma", 'w', sizeof(int));
+}
+
+int f23(int x) {
+  return target(6, "delta", 'x', sizeof(long));
+}
+
+int f24(int x) {
+  return CALL(2, "epsilon");
+}
+
+int f25(int x) {
+  return target(8, "alpha", 'z', sizeof(char));
+}
+
+int f26(int x) {
+  return target(9, "beta", 'a', sizeof(short));
+}
+
+int f27(int x) {
+  return target(10, "gamma", 'b', sizeof(int));
+}
+
+int f28(int x) {
+  return target(11, "delta", 'c', sizeof(long));
+}
+
+int f29(int x) {
+  return target(12, "epsilon", 'd', sizeof(double));
+}
+
+int f30(int x) {
+  return target(13, "alpha", 'e', sizeof(char));
+}
+
+int f31(int x) {
+  return CALL(9, "beta");
+}
+
+int f32(int x) {
+  return target(15, "gamma", 'g', sizeof(int));
+}
+
+int f33(int x) {
+  return target(16, "delta", 'h', sizeof(long));
+}
+
+int f34(int x) {
+  return target(0, "epsilon", 'i', sizeof(double));
+}
+
+int f35(int x) {
+  return target(1, "alpha", 'j', sizeof(char));
+}
+
+int f36(int x) {
+  return target(2, "beta", 'k', sizeof(short));
+}
+
+int f37(int x) {
+  return target(3, "gamma", 'l', sizeof(int));
+}
+
+int f38(int x) {
+  return CALL(5, "delta");
+}
+
+int f39(int x) {
+  return target(5, "epsilon", 'n', sizeof(double));
+}
+
+int f40(int x) {
+  return target(6, "alpha", 'o', sizeof(char));
+}
+
+int f41(int x) {
+  return target(7, "beta", 'p', sizeof(short));
+}
+
+int f42(int x) {
+  return target(8, "gamma", 'q', sizeof(int));
+}
+
+int f43(int x) {
+  return target(9, "delta", 'r', sizeof(long));
+}
+
+int f44(int x) {
+  return target(x, "beta", 's', sizeof(x));
+}
+
+int f45(int x) {
+  return CALL(1, "alpha");
+}
+
+int f46(int x) {
+  return target(12, "beta", 'u', sizeof(short));
+}
+
+int f47(int x) {
+  return target(13, "gamma", 'v', sizeof(int));
+}